@@ -0,0 +1,167 @@
+// Measures the per-frame cost of ParticleSystem::update for large particle
+// counts, with the exact per-particle wind blend and with the baked wind
+// field, for every integration kernel the CPU supports. Also reports how far
+// the SIMD kernels drift from the scalar reference and the baked field's
+// error at several resolutions, and how the update scales with worker
+// threads.
+// Runs on the CPU only, no GL context is created.
+//
+// usage: particle_bench [frames] [dt]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+#include "particle_system.hpp"
+#include "thread_pool.hpp"
+#include "wind_field.hpp"
+#include "wind_grid.hpp"
+
+using ParticleKernels::Kernel;
+
+static void runUpdates(const char *label, size_t count, int frames, float dt, WindGrid &windGrid,
+                       const WindField *windField, Kernel kernel, ThreadPool *threadPool = nullptr) {
+    ParticleSystem particleSystem(count);
+    particleSystem.setWindField(windField);
+    particleSystem.setKernel(kernel);
+    particleSystem.setThreadPool(threadPool);
+    auto emitStart = std::chrono::steady_clock::now();
+    particleSystem.emit(glm::vec3(22.0f, 2.5f, 4.0f), static_cast<int>(count / 2.5));
+    auto emitEnd = std::chrono::steady_clock::now();
+    const size_t emitted = particleSystem.size();
+
+    double totalMs = 0.0;
+    double worstMs = 0.0;
+    for (int frame = 0; frame < frames; ++frame) {
+        auto start = std::chrono::steady_clock::now();
+        particleSystem.update(dt, windGrid);
+        auto end = std::chrono::steady_clock::now();
+
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        totalMs += ms;
+        if (ms > worstMs)
+            worstMs = ms;
+    }
+
+    std::cout << label << " " << ParticleKernels::getKernelName(kernel)
+              << " threads=" << (threadPool ? threadPool->getThreadCount() : 1)
+              << " particles=" << emitted
+              << " emit=" << std::chrono::duration<double, std::milli>(emitEnd - emitStart).count() << " ms"
+              << " mean=" << totalMs / frames << " ms"
+              << " worst=" << worstMs << " ms"
+              << " alive=" << particleSystem.size() << "\n";
+}
+
+// Runs the same emission through the scalar kernel and another one and
+// reports the largest position difference between the two.
+static void compareWithScalar(Kernel kernel, int frames, float dt, WindGrid &windGrid, const WindField *windField) {
+    ParticleSystem reference(50000), candidate(50000);
+    reference.setKernel(Kernel::Scalar);
+    candidate.setKernel(kernel);
+
+    for (ParticleSystem *particleSystem : { &reference, &candidate }) {
+        particleSystem->setSeed(1);
+        particleSystem->setWindField(windField);
+        particleSystem->emit(glm::vec3(22.0f, 2.5f, 4.0f), 20000);
+        for (int frame = 0; frame < frames; ++frame)
+            particleSystem->update(dt, windGrid);
+    }
+
+    const ParticleData &a = reference.getParticles();
+    const ParticleData &b = candidate.getParticles();
+    if (a.size() != b.size()) {
+        std::cout << ParticleKernels::getKernelName(kernel) << " vs scalar: alive count differs ("
+                  << b.size() << " vs " << a.size() << ")\n";
+        return;
+    }
+
+    float maxError = 0.0f;
+    for (size_t i = 0; i < a.size(); ++i)
+        maxError = std::max(maxError, glm::distance(a.getPosition(i), b.getPosition(i)));
+
+    std::cout << ParticleKernels::getKernelName(kernel) << " vs scalar: max position error=" << maxError
+              << " over " << a.size() << " particles\n";
+}
+
+// Checks that the update result does not depend on the number of threads.
+static void compareThreadCounts(unsigned int threadCount, int frames, float dt, WindGrid &windGrid, const WindField *windField) {
+    ThreadPool single(1), multi(threadCount);
+    ParticleSystem reference(200000), candidate(200000);
+    reference.setThreadPool(&single);
+    candidate.setThreadPool(&multi);
+
+    for (ParticleSystem *particleSystem : { &reference, &candidate }) {
+        particleSystem->setSeed(1);
+        particleSystem->setWindField(windField);
+        particleSystem->emit(glm::vec3(22.0f, 2.5f, 4.0f), 80000);
+        for (int frame = 0; frame < frames; ++frame)
+            particleSystem->update(dt, windGrid);
+    }
+
+    const ParticleData &a = reference.getParticles();
+    const ParticleData &b = candidate.getParticles();
+    bool identical = a.positionX == b.positionX && a.positionY == b.positionY && a.positionZ == b.positionZ &&
+                     a.life == b.life && a.velocity == b.velocity;
+
+    std::cout << threadCount << " threads vs 1: " << (identical ? "identical" : "DIFFERENT")
+              << " (" << b.size() << " particles)\n";
+}
+
+int main(int argc, char **argv) {
+    const int frames = argc > 1 ? std::atoi(argv[1]) : 100;
+    const float dt = argc > 2 ? static_cast<float>(std::atof(argv[2])) : 0.05f;
+    const size_t counts[] = { 50000, 500000, 5000000 };
+    const float cellSizes[] = { 0.5f, 0.25f, 0.1f, 0.05f };
+
+    WindGrid windGrid;
+    windGrid.initialize();
+
+    WindField windField;
+    windField.bake(windGrid);
+
+    std::cout << "frames=" << frames << " dt=" << dt << "\n";
+
+    for (size_t count : counts) {
+        runUpdates("exact", count, frames, dt, windGrid, nullptr, Kernel::Scalar);
+        for (Kernel kernel : { Kernel::Scalar, Kernel::SSE41, Kernel::AVX2 }) {
+            if (ParticleKernels::isSupported(kernel))
+                runUpdates("baked", count, frames, dt, windGrid, &windField, kernel);
+        }
+    }
+
+    std::cout << "\n";
+    for (Kernel kernel : { Kernel::SSE41, Kernel::AVX2 }) {
+        if (ParticleKernels::isSupported(kernel))
+            compareWithScalar(kernel, frames, dt, windGrid, &windField);
+    }
+
+    std::cout << "\n";
+    const unsigned int hardwareThreads = ThreadPool::defaultThreadCount();
+    for (unsigned int threads = 1; ; threads = std::min(threads * 2, hardwareThreads)) {
+        ThreadPool threadPool(threads);
+        runUpdates("baked", 5000000, frames, dt, windGrid, &windField, ParticleKernels::detectBestKernel(), &threadPool);
+        if (threads == hardwareThreads)
+            break;
+    }
+    compareThreadCounts(std::max(4u, hardwareThreads), frames, dt, windGrid, &windField);
+
+    std::cout << "\nwind field error against WindGrid::blendAtPoint (1000x1000 samples)\n";
+    for (float cellSize : cellSizes) {
+        WindField field;
+        auto start = std::chrono::steady_clock::now();
+        field.bake(windGrid, cellSize);
+        auto end = std::chrono::steady_clock::now();
+
+        WindFieldError error = field.measureError(windGrid, 1000);
+        std::cout << "cell=" << cellSize
+                  << " nodes=" << field.getWidth() << "x" << field.getHeight()
+                  << " bake=" << std::chrono::duration<double, std::milli>(end - start).count() << " ms"
+                  << " angle mean/max=" << error.meanAngleDeg << "/" << error.maxAngleDeg << " deg"
+                  << " velocity mean/max=" << error.meanVelocity << "/" << error.maxVelocity
+                  << " coverage mismatch=" << error.coverageMismatch * 100.0f << "%\n";
+    }
+
+    return 0;
+}
@@ -4,7 +4,11 @@ in float intens;
 
 out vec4 FragColor;
 
+uniform float deltaTime;
+
 void main() {
 
-    FragColor = vec4(0.0, 0.0 ,0.0 ,intens);
+    // Blended additively: every frame a particle covers a texel adds its
+    // intensity times the frame time, as DepositionGrid::deposit does
+    FragColor = vec4(min(intens, 1.0) * deltaTime, 0.0, 0.0, 1.0);
 }
@@ -0,0 +1,13 @@
+#version 330 core
+
+in vec2 TexCoord;
+
+out vec4 FragColor;
+
+uniform sampler2D source;
+uniform float factor;
+
+void main() {
+
+    FragColor = vec4(texture(source, TexCoord).r * factor, 0.0, 0.0, 1.0);
+}
@@ -3,14 +3,26 @@ layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
 
+// One model per instance, see MeshInstance
+layout (location = 3) in mat4 instanceModel;
+layout (location = 7) in vec4 instanceHighlight;
+
 out vec2 TexCoords;
+out vec4 Highlight;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 cameraRight;
+    vec4 cameraUp;
+    vec4 cameraFront;
+};
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
-}
\ No newline at end of file
+    Highlight = instanceHighlight;
+    gl_Position = viewProjection * instanceModel * vec4(aPos, 1.0);
+}
@@ -8,22 +8,26 @@ layout (location = 3) in float scale;
 out float fIntensity;
 out vec2 texCoord;
 
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 cameraRight;
+    vec4 cameraUp;
+    vec4 cameraFront;
+};
 
 void main() {
 
     // billboard
-    vec3 cameraRight = vec3(view[0][0], view[1][0], view[2][0]);
-    vec3 cameraUp    = vec3(view[0][1], view[1][1], view[2][1]);
-
     vec2 scaledQuad = quadPos * scale;
 
     vec3 worldPos = instancePos
-                  + cameraRight * scaledQuad.x
-                  + cameraUp    * scaledQuad.y;
+                  + cameraRight.xyz * scaledQuad.x
+                  + cameraUp.xyz    * scaledQuad.y;
 
-    gl_Position = projection * view * vec4(worldPos, 1.0);
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
     fIntensity = intensity;
 
     texCoord = quadPos + vec2(0.5);
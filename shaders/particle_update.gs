@@ -0,0 +1,31 @@
+#version 330 core
+
+// Passes live particles through to the feedback buffer and drops dead ones,
+// which compacts the particle buffer on the way.
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec3 vPosition[];
+in vec3 vDirection[];
+in float vVelocity[];
+in float vLife[];
+in float vScale[];
+
+out vec3 outPosition;
+out vec3 outDirection;
+out float outVelocity;
+out float outLife;
+out float outScale;
+
+void main() {
+    if (vLife[0] <= 0.0)
+        return;
+
+    outPosition = vPosition[0];
+    outDirection = vDirection[0];
+    outVelocity = vVelocity[0];
+    outLife = vLife[0];
+    outScale = vScale[0];
+    EmitVertex();
+    EndPrimitive();
+}
@@ -0,0 +1,60 @@
+#version 330 core
+
+layout (location = 0) in vec3 inPosition;
+layout (location = 1) in vec3 inDirection;
+layout (location = 2) in float inVelocity;
+layout (location = 3) in float inLife;
+layout (location = 4) in float inScale;
+
+out vec3 vPosition;
+out vec3 vDirection;
+out float vVelocity;
+out float vLife;
+out float vScale;
+
+uniform float deltaTime;
+uniform float windVelocityScale;
+
+uniform bool hasWindField;
+uniform sampler2D windField;
+uniform vec2 windFieldOrigin;
+uniform vec2 windFieldSize;
+uniform float windFieldCellSize;
+
+// Same as WindField::sample: bilinear blend of the baked lattice, calm where
+// less than half of the footprint carries wind.
+bool sampleWind(vec2 position, out vec3 direction, out float velocity) {
+    vec2 local = (position - windFieldOrigin) / windFieldCellSize;
+    if (!hasWindField || any(lessThan(local, vec2(0.0))) || any(greaterThanEqual(local, windFieldSize - 1.0)))
+        return false;
+
+    vec4 blended = texture(windField, (local + 0.5) / windFieldSize);
+    if (blended.w < 0.5)
+        return false;
+
+    float len = length(blended.xy);
+    if (len < 1e-6)
+        return false;
+
+    direction = vec3(blended.x / len, 0.0, blended.y / len);
+    velocity = blended.z / blended.w;
+    return true;
+}
+
+void main() {
+    vec3 direction = inDirection;
+    float velocity = inVelocity;
+
+    vec3 windDirection;
+    float windVelocity;
+    if (sampleWind(inPosition.xz, windDirection, windVelocity)) {
+        direction = normalize(mix(direction, windDirection, 0.1));
+        velocity = mix(velocity, windVelocity * windVelocityScale, 0.1);
+    }
+
+    vPosition = inPosition + velocity * direction * deltaTime;
+    vDirection = direction;
+    vVelocity = velocity;
+    vLife = inLife - deltaTime;
+    vScale = inScale;
+}
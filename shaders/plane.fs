@@ -5,10 +5,47 @@ in vec2 TexCoord;
 uniform sampler2D Tex;
 uniform sampler2D ContaminationTex;
 
+// Sparse contamination: grid tiles live in an atlas, the page table gives
+// each tile's slot in it or -1 for a clean tile
+uniform bool SparseContamination;
+uniform isampler2D ContaminationPages;
+uniform sampler2D ContaminationAtlas;
+uniform int ContaminationWidth;
+uniform int ContaminationHeight;
+uniform int ContaminationTileSize;
+uniform int AtlasColumns;
+
+float fetchCell(ivec2 cell)
+{
+    if (cell.x < 0 || cell.y < 0 || cell.x >= ContaminationWidth || cell.y >= ContaminationHeight)
+        return 0.0;
+
+    int slot = texelFetch(ContaminationPages, cell / ContaminationTileSize, 0).r;
+    if (slot < 0)
+        return 0.0;
+
+    ivec2 origin = ivec2(slot % AtlasColumns, slot / AtlasColumns) * ContaminationTileSize;
+    return texelFetch(ContaminationAtlas, origin + cell % ContaminationTileSize, 0).r;
+}
+
+// Bilinear by hand, since neighbouring cells may sit in different atlas slots
+float sampleSparse(vec2 uv)
+{
+    vec2 position = uv * vec2(ContaminationWidth, ContaminationHeight) - 0.5;
+    ivec2 cell = ivec2(floor(position));
+    vec2 f = position - floor(position);
+
+    float bottom = mix(fetchCell(cell), fetchCell(cell + ivec2(1, 0)), f.x);
+    float top = mix(fetchCell(cell + ivec2(0, 1)), fetchCell(cell + ivec2(1, 1)), f.x);
+    return mix(bottom, top, f.y);
+}
+
 void main()
 {
     vec3 baseColor = texture(Tex, TexCoord).rgb;              
-    float intensity = texture(ContaminationTex, TexCoord).a; 
+    float intensity = SparseContamination
+        ? sampleSparse(TexCoord)
+        : texture(ContaminationTex, TexCoord).r;
 
     vec3 colorLow = vec3(1.0, 1.0, 0.0);
     vec3 colorMid = vec3(1.0, 0.5, 0.0);
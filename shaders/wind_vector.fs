@@ -1,10 +1,10 @@
 #version 330 core
 out vec4 FragColor;
 
-uniform vec3 color;
-uniform float alpha;
+in vec3 Color;
+in float Alpha;
 
 void main()
 {
-    FragColor = vec4(color, alpha);
+    FragColor = vec4(Color, Alpha);
 }
@@ -1,11 +1,53 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// One wind vector per instance
+layout (location = 1) in vec3 instancePosition;
+layout (location = 2) in float instanceAngle;
+layout (location = 3) in vec3 instanceColor;
+layout (location = 4) in float instanceSpeedFactor;
+layout (location = 5) in vec2 instanceDirection;
+
+layout (std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 cameraRight;
+    vec4 cameraUp;
+    vec4 cameraFront;
+};
+
+uniform float time;
+// The outline pass draws a slightly wider white arrow under the coloured one
+uniform bool outline;
+
+out vec3 Color;
+out float Alpha;
+
+const float moveFactor = 2.0;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
+    // Arrows slide along the wind and fade out, faster for stronger wind
+    float phase = fract(instanceSpeedFactor * time);
+
+    vec3 local = aPos * vec3(1.0, 1.0, 0.5);
+    if (outline)
+        local *= vec3(1.05, 1.0, 1.05);
+    else
+        local.y += 0.01;
+
+    // Rotation about +y, as glm::rotate builds it
+    float c = cos(instanceAngle);
+    float s = sin(instanceAngle);
+    vec3 rotated = vec3(c * local.x + s * local.z, local.y, -s * local.x + c * local.z);
+
+    vec3 worldPos = instancePosition
+                  + moveFactor * phase * vec3(instanceDirection.x, 0.0, instanceDirection.y)
+                  + rotated;
+
+    gl_Position = viewProjection * vec4(worldPos, 1.0);
+    Color = outline ? vec3(1.0) : instanceColor;
+    Alpha = 1.0 - phase;
 }
@@ -0,0 +1,163 @@
+#include "asset_loader.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+AssetLoader::AssetLoader(unsigned int workerCount) {
+    for (unsigned int i = 0; i < workerCount; ++i)
+        workers.emplace_back(&AssetLoader::run, this);
+}
+
+AssetLoader::~AssetLoader() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+}
+
+unsigned int AssetLoader::defaultWorkerCount() {
+    // Loading is mostly decoding, a few threads cover the handful of assets
+    return std::clamp(std::thread::hardware_concurrency(), 2u, 4u);
+}
+
+double AssetLoader::now() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+void AssetLoader::submit(const std::string& name, Work work) {
+    std::unique_lock<std::mutex> lock(mutex);
+    Job& job = jobs.emplace_back();
+    job.name = name;
+    job.work = std::move(work);
+    job.queued = now();
+    ++remaining;
+
+    if (workers.empty()) {
+        lock.unlock();
+        job.workStart = now();
+        job.upload = job.work();
+        job.workEnd = now();
+        runUpload(job);
+        return;
+    }
+
+    queued.push_back(jobs.size() - 1);
+    lock.unlock();
+    wakeUp.notify_one();
+}
+
+void AssetLoader::run() {
+    for (;;) {
+        size_t index;
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this] { return stopping || !queued.empty(); });
+            if (stopping)
+                return;
+            index = queued.front();
+            queued.pop_front();
+            job = &jobs[index];
+            job->workStart = now();
+        }
+
+        Upload upload = job->work();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        job->upload = std::move(upload);
+        job->workEnd = now();
+        finished.push_back(index);
+    }
+}
+
+void AssetLoader::runUpload(Job& job) {
+    job.uploadStart = now();
+    if (job.upload)
+        job.upload();
+    job.uploadEnd = now();
+    job.work = nullptr;
+    job.upload = nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    --remaining;
+}
+
+void AssetLoader::pump(double budgetMs) {
+    const double deadline = now() + budgetMs;
+    for (;;) {
+        Job* job = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!finished.empty()) {
+                job = &jobs[finished.front()];
+                finished.pop_front();
+            }
+        }
+        if (!job)
+            break;
+        runUpload(*job);
+        if (now() >= deadline)
+            break;
+    }
+
+    if (isDone() && !reported) {
+        mark("all assets ready");
+        reported = true;
+        printReport(std::cout);
+    }
+}
+
+bool AssetLoader::isDone() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return remaining == 0;
+}
+
+size_t AssetLoader::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return remaining;
+}
+
+void AssetLoader::mark(const std::string& event) {
+    std::lock_guard<std::mutex> lock(mutex);
+    milestones.push_back({ event, now() });
+}
+
+void AssetLoader::printReport(std::ostream& out) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision();
+
+    out << "[AssetLoader] startup with " << workers.size() << " workers, ms since launch\n"
+        << std::fixed << std::setprecision(1);
+    for (const Milestone& milestone : milestones)
+        out << "  " << std::left << std::setw(36) << milestone.event << std::right << std::setw(8) << milestone.time << "\n";
+
+    out << "  " << std::left << std::setw(36) << "asset" << std::right
+        << std::setw(8) << "queued" << std::setw(8) << "work" << std::setw(8) << "wait" << std::setw(8) << "upload"
+        << std::setw(8) << "ready" << "\n";
+    double serial = 0.0;
+    const Job* last = nullptr;
+    for (const Job& job : jobs) {
+        const double work = job.workEnd - job.workStart, upload = job.uploadEnd - job.uploadStart;
+        serial += work + upload;
+        if (!last || job.uploadEnd > last->uploadEnd)
+            last = &job;
+        out << "  " << std::left << std::setw(36) << job.name << std::right
+            << std::setw(8) << job.queued << std::setw(8) << work << std::setw(8) << job.uploadStart - job.workEnd
+            << std::setw(8) << upload << std::setw(8) << job.uploadEnd << "\n";
+    }
+
+    out << "  serial cost of all jobs " << serial << " ms\n";
+    if (last) {
+        out << "  critical path ends with " << last->name << ": waited " << last->workStart - last->queued
+            << " for a worker, worked " << last->workEnd - last->workStart << ", waited "
+            << last->uploadStart - last->workEnd << " for the context thread, uploaded "
+            << last->uploadEnd - last->uploadStart << "\n";
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
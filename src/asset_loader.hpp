@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Loads assets in two halves: the work (file I/O, decoding, mesh import) runs
+// on worker threads and returns the upload, which pump() runs later on the
+// thread that owns the GL context. Until an asset's upload has run its slot
+// stays empty and whoever draws it skips it.
+//
+// Every job is timed from the loader's construction, which is close enough
+// to process start, together with milestones the program marks, and a
+// report shows which asset held up startup. With no workers each job runs
+// to completion inside submit, the serial startup to compare against.
+class AssetLoader {
+public:
+    using Upload = std::function<void()>;
+    using Work = std::function<Upload()>;
+
+    explicit AssetLoader(unsigned int workerCount = defaultWorkerCount());
+    ~AssetLoader();
+
+    AssetLoader(const AssetLoader&) = delete;
+    AssetLoader& operator=(const AssetLoader&) = delete;
+
+    static unsigned int defaultWorkerCount();
+
+    void submit(const std::string& name, Work work);
+
+    // Runs finished uploads on the calling thread until budgetMs has passed,
+    // always at least one. Prints the report the first time nothing is left.
+    void pump(double budgetMs);
+
+    bool isDone() const;
+    size_t getPendingCount() const;
+
+    // Records a startup milestone such as the first frame
+    void mark(const std::string& event);
+    void printReport(std::ostream& out) const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Job {
+        std::string name;
+        Work work;
+        Upload upload;
+        double queued = 0.0, workStart = 0.0, workEnd = 0.0, uploadStart = 0.0, uploadEnd = 0.0;
+    };
+
+    struct Milestone {
+        std::string event;
+        double time;
+    };
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+
+    mutable std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::deque<size_t> queued;   // jobs waiting for a worker
+    std::deque<size_t> finished; // jobs waiting for their upload
+    std::deque<Job> jobs;        // stable addresses, never shrinks
+    size_t remaining = 0;        // submitted jobs whose upload has not run
+    bool stopping = false;
+    bool reported = false;
+    std::vector<Milestone> milestones;
+
+    double now() const;
+    void run();
+    void runUpload(Job& job);
+};
@@ -0,0 +1,33 @@
+#include "camera_uniforms.hpp"
+
+// std140 lays mat4 and vec4 out as the tightly packed struct does
+static_assert(sizeof(CameraUniforms) == 3 * 64 + 4 * 16, "CameraUniforms must match the std140 Camera block");
+
+CameraUniformBuffer::~CameraUniformBuffer() {
+    if (ubo)
+        glDeleteBuffers(1, &ubo);
+}
+
+void CameraUniformBuffer::initialize() {
+    if (!ubo)
+        glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraUniforms), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+}
+
+void CameraUniformBuffer::update(Camera& camera, const glm::mat4& projection) {
+    uniforms.view = camera.GetViewMatrix();
+    uniforms.projection = projection;
+    uniforms.viewProjection = projection * uniforms.view;
+    uniforms.position = glm::vec4(camera.Position, 1.0f);
+    uniforms.right = glm::vec4(camera.Right, 0.0f);
+    uniforms.up = glm::vec4(camera.Up, 0.0f);
+    uniforms.front = glm::vec4(camera.Front, 0.0f);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraUniforms), &uniforms);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, ubo);
+}
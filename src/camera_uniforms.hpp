@@ -0,0 +1,53 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.hpp"
+
+// Per-frame camera state shared by every shader that draws through the
+// camera, as the std140 uniform block
+//
+//     layout (std140) uniform Camera {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 viewProjection;
+//         vec4 cameraPosition;
+//         vec4 cameraRight;
+//         vec4 cameraUp;
+//         vec4 cameraFront;
+//     };
+//
+// Shader binds any block named Camera to binding when it links, so the buffer
+// is filled once per frame and no draw sets these matrices itself.
+struct CameraUniforms {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    glm::vec4 position; // w unused, as for the vectors below
+    glm::vec4 right;
+    glm::vec4 up;
+    glm::vec4 front;
+};
+
+class CameraUniformBuffer {
+public:
+    static constexpr GLuint binding = 0;
+    static constexpr const char* blockName = "Camera";
+
+    CameraUniformBuffer() = default;
+    ~CameraUniformBuffer();
+
+    CameraUniformBuffer(const CameraUniformBuffer&) = delete;
+    CameraUniformBuffer& operator=(const CameraUniformBuffer&) = delete;
+
+    void initialize();
+    // Fills the block from the camera and leaves it bound to binding
+    void update(Camera& camera, const glm::mat4& projection);
+
+    const CameraUniforms& getUniforms() const { return uniforms; }
+
+private:
+    GLuint ubo = 0;
+    CameraUniforms uniforms{};
+};
@@ -1,46 +1,277 @@
 #include "contamination.hpp"
+#include <algorithm>
 #include <iostream>
 
 
+Contamination::~Contamination() {
+    release();
+}
+
 void Contamination::initialize(unsigned int width, unsigned int height) {
+    release();
+    glGenVertexArrays(1, &emptyVAO);
+    allocate(width, height);
+}
+
+// R16F keeps the contour thresholds exact to a few parts in ten thousand at
+// half the size of the old RGBA8 mask, and additive blending into it does not
+// clamp at 1.
+void Contamination::allocate(unsigned int width, unsigned int height) {
     texWidth = width;
     texHeight = height;
+    uploadedGrid = nullptr;
+    current = 0;
 
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0,
-                 GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glGenTextures(2, textures);
+    glGenFramebuffers(2, fbos);
 
-    glGenFramebuffers(1, &fbo);
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
-                           GL_TEXTURE_2D, texture, 0);
+    for (int i = 0; i < 2; ++i) {
+        glBindTexture(GL_TEXTURE_2D, textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, width, height, 0,
+                     GL_RED, GL_FLOAT, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
-        std::cerr << "[ContaminationBuffer] ERROR: FBO not complete!\n";
+        glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_TEXTURE_2D, textures[i], 0);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "[ContaminationBuffer] ERROR: FBO not complete!\n";
+        }
     }
 
+    glBindTexture(GL_TEXTURE_2D, 0);
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
+void Contamination::release() {
+    if (!textures[0])
+        return;
+
+    glDeleteFramebuffers(2, fbos);
+    glDeleteTextures(2, textures);
+    glDeleteVertexArrays(1, &emptyVAO);
+    textures[0] = textures[1] = 0;
+    fbos[0] = fbos[1] = 0;
+    emptyVAO = 0;
+
+    if (pageTable) {
+        glDeleteTextures(1, &pageTable);
+        glDeleteTextures(1, &atlas);
+        pageTable = atlas = 0;
+        atlasRows = 0;
+    }
+    uploadedGrid = nullptr;
+}
+
+// Drawing into the dense texture shows it again in place of an uploaded grid
 void Contamination::bind() {
-    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    uploadedGrid = nullptr;
+    glGetIntegerv(GL_VIEWPORT, savedViewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbos[current]);
     glViewport(0, 0, texWidth, texHeight);
 }
 
 void Contamination::unbind() {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
 }
 
 GLuint Contamination::getTextureID() const {
-    return texture;
+    return textures[current];
 }
 
 void Contamination::clear() {
+    pendingDecay.reset();
     bind();
     glClearColor(0, 0, 0, 0);
     glClear(GL_COLOR_BUFFER_BIT);
     unbind();
 }
+
+Contamination::SamplingUniforms Contamination::SamplingUniforms::locate(const Shader& shader) {
+    SamplingUniforms uniforms;
+    uniforms.sparse = shader.getUniformLocation("SparseContamination");
+    uniforms.texture = shader.getUniformLocation("ContaminationTex");
+    uniforms.pages = shader.getUniformLocation("ContaminationPages");
+    uniforms.atlas = shader.getUniformLocation("ContaminationAtlas");
+    uniforms.width = shader.getUniformLocation("ContaminationWidth");
+    uniforms.height = shader.getUniformLocation("ContaminationHeight");
+    uniforms.tileSize = shader.getUniformLocation("ContaminationTileSize");
+    uniforms.atlasColumns = shader.getUniformLocation("AtlasColumns");
+    return uniforms;
+}
+
+void Contamination::bindForSampling(const Shader& shader, const SamplingUniforms& uniforms) const {
+    const bool sparse = uploadedGrid != nullptr;
+    shader.setBool(uniforms.sparse, sparse);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, textures[current]);
+    shader.setInt(uniforms.texture, 1);
+
+    if (!sparse) {
+        glActiveTexture(GL_TEXTURE0);
+        return;
+    }
+
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, pageTable);
+    shader.setInt(uniforms.pages, 2);
+    glActiveTexture(GL_TEXTURE3);
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    shader.setInt(uniforms.atlas, 3);
+    glActiveTexture(GL_TEXTURE0);
+
+    shader.setInt(uniforms.width, uploadedGrid->getWidth());
+    shader.setInt(uniforms.height, uploadedGrid->getHeight());
+    shader.setInt(uniforms.tileSize, DepositionGrid::tileSize);
+    shader.setInt(uniforms.atlasColumns, atlasColumns);
+}
+
+// Forgets every atlas slot and sizes the page table to the grid's tiles.
+void Contamination::resetSparse(const DepositionGrid& grid) {
+    slots.assign(static_cast<size_t>(grid.getTilesX()) * grid.getTilesZ(), -1);
+    usedSlots = 0;
+
+    if (!pageTable) {
+        GLint maxTextureSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+        maxAtlasRows = std::max(maxTextureSize / DepositionGrid::tileSize, initialAtlasRows);
+
+        glGenTextures(1, &pageTable);
+        glBindTexture(GL_TEXTURE_2D, pageTable);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        growAtlas(initialAtlasRows * atlasColumns);
+    }
+
+    glBindTexture(GL_TEXTURE_2D, pageTable);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32I, grid.getTilesX(), grid.getTilesZ(), 0,
+                 GL_RED_INTEGER, GL_INT, slots.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Doubles the atlas height until neededSlots fit or it reaches the largest
+// texture GL allows. The old contents are dropped; the caller uploads every
+// tile again.
+void Contamination::growAtlas(int neededSlots) {
+    int rows = std::max(atlasRows, initialAtlasRows);
+    while (rows * atlasColumns < neededSlots && rows < maxAtlasRows)
+        rows *= 2;
+    rows = std::min(rows, maxAtlasRows);
+    if (rows * atlasColumns < neededSlots) {
+        std::cerr << "[Contamination] ERROR: " << neededSlots << " contaminated tiles do not fit the largest atlas of "
+                  << rows * atlasColumns << ", the rest are not shown\n";
+    }
+
+    if (!atlas) {
+        glGenTextures(1, &atlas);
+        glBindTexture(GL_TEXTURE_2D, atlas);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    }
+
+    atlasRows = rows;
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, atlasColumns * DepositionGrid::tileSize, atlasRows * DepositionGrid::tileSize, 0,
+                 GL_RED, GL_FLOAT, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Only tiles written since the last upload are copied, under the grid's lock,
+// and uploaded after it is released, so the simulation thread only waits for
+// the copy. New tiles take the next free atlas slot.
+void Contamination::upload(const DepositionGrid& grid) {
+    uint64_t version = grid.getVersion();
+    if (&grid == uploadedGrid && version == uploadedVersion)
+        return;
+
+    bool everything = &grid != uploadedGrid || grid.getGeneration() != uploadedGeneration;
+    uploadedGeneration = grid.getGeneration();
+    if (everything)
+        resetSparse(grid);
+
+    changedTiles.clear();
+    staging.clear();
+    grid.takeChangedTiles(changedTiles, staging, everything);
+
+    int newSlots = 0;
+    for (uint32_t tile : changedTiles)
+        newSlots += slots[tile] < 0;
+
+    if (usedSlots + newSlots > atlasRows * atlasColumns && atlasRows < maxAtlasRows) {
+        growAtlas(usedSlots + newSlots);
+        std::fill(slots.begin(), slots.end(), -1);
+        usedSlots = 0;
+
+        changedTiles.clear();
+        staging.clear();
+        grid.takeChangedTiles(changedTiles, staging, true);
+        newSlots = static_cast<int>(changedTiles.size());
+    }
+
+    const int previouslyUsed = usedSlots;
+    glBindTexture(GL_TEXTURE_2D, atlas);
+    for (size_t i = 0; i < changedTiles.size(); ++i) {
+        int32_t& slot = slots[changedTiles[i]];
+        if (slot < 0) {
+            if (usedSlots == atlasRows * atlasColumns)
+                continue;
+            slot = usedSlots++;
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, 0,
+                        (slot % atlasColumns) * DepositionGrid::tileSize, (slot / atlasColumns) * DepositionGrid::tileSize,
+                        DepositionGrid::tileSize, DepositionGrid::tileSize,
+                        GL_RED, GL_FLOAT, &staging[i * DepositionGrid::tileCells]);
+    }
+
+    if (usedSlots > previouslyUsed) {
+        glBindTexture(GL_TEXTURE_2D, pageTable);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, grid.getTilesX(), grid.getTilesZ(),
+                        GL_RED_INTEGER, GL_INT, slots.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    uploadedGrid = &grid;
+    uploadedVersion = version;
+}
+
+void Contamination::decay(const Shader& shader, GLint factorLocation, double factor) {
+    const float step = pendingDecay.take(factor);
+    if (step == 1.0f)
+        return;
+
+    const int target = 1 - current;
+
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glDisable(GL_DEPTH_TEST);
+
+    glGetIntegerv(GL_VIEWPORT, savedViewport);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbos[target]);
+    glViewport(0, 0, texWidth, texHeight);
+
+    shader.use();
+    shader.setFloat(factorLocation, step);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, textures[current]);
+
+    // One triangle covering the viewport, positions made up in the vertex shader
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+
+    unbind();
+    current = target;
+
+    if (blend)
+        glEnable(GL_BLEND);
+    if (depthTest)
+        glEnable(GL_DEPTH_TEST);
+}
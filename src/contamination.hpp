@@ -1,21 +1,89 @@
 #pragma once
 
 #include <glad/glad.h>
+#include <cstdint>
 #include <vector>
-#include "particle_system.hpp"
 
+#include "decay_accumulator.hpp"
+#include "deposition_grid.hpp"
+#include "shader.hpp"
+
+// Ground contamination over the map, in the same units as a DepositionGrid,
+// in one of two forms the plane shader can sample:
+//  - a dense single-channel float texture that particles are splatted into
+//    additively; radioactive decay runs as a ping-pong pass between two
+//    textures, so history never has to be drawn again;
+//  - a sparse copy of a CPU grid: its allocated tiles packed into an atlas
+//    texture and a page table texture giving each grid tile's slot in the
+//    atlas, or -1. Only tiles changed since the last upload are copied, and
+//    memory follows the contaminated area rather than the grid resolution.
 class Contamination {
 public:
+    ~Contamination();
+
     void initialize(unsigned int width, unsigned int height);
     void bind();
     void unbind();
     void clear();
+    // Shows a CPU deposition grid instead of the dense texture until the next
+    // clear(). Does nothing if the grid has not changed since the last upload.
+    void upload(const DepositionGrid& grid);
+    // Multiplies every texel by factor, drawing the current texture into the
+    // other one with the decay shader, whose source sampler reads unit 0 and
+    // whose factor uniform is at factorLocation. Factors too close to 1 for
+    // R16F are gathered over several calls and applied together.
+    void decay(const Shader& shader, GLint factorLocation, double factor);
     GLuint getTextureID() const;
+    // Framebuffer holding the current dense texture, for reading it back
+    GLuint getFramebuffer() const { return fbos[current]; }
+    unsigned int getWidth() const { return texWidth; }
+    unsigned int getHeight() const { return texHeight; }
+    // Locations bindForSampling() sets, looked up once the shader links
+    struct SamplingUniforms {
+        GLint sparse = -1;
+        GLint texture = -1;
+        GLint pages = -1;
+        GLint atlas = -1;
+        GLint width = -1;
+        GLint height = -1;
+        GLint tileSize = -1;
+        GLint atlasColumns = -1;
+
+        static SamplingUniforms locate(const Shader& shader);
+    };
+    // Binds whichever form is shown to texture units 1 to 3 of the plane shader
+    void bindForSampling(const Shader& shader, const SamplingUniforms& uniforms) const;
 
 private:
-    GLuint texture = 0;
-    GLuint fbo = 0;
+    GLuint textures[2] = {};
+    GLuint fbos[2] = {};
+    GLuint emptyVAO = 0;
+    int current = 0;
+    DecayAccumulator pendingDecay;
 
     unsigned int texWidth = 0;
     unsigned int texHeight = 0;
+    // Sparse form; atlas slots run along rows of atlasColumns tiles and the
+    // atlas only grows in height, up to the largest texture GL allows. Tiles
+    // beyond that stay out of the page table and show as clean.
+    static constexpr int atlasColumns = 32;
+    static constexpr int initialAtlasRows = 4;
+    GLuint pageTable = 0;
+    GLuint atlas = 0;
+    int atlasRows = 0;
+    int maxAtlasRows = 0;
+    std::vector<int32_t> slots; // atlas slot of every grid tile, or -1
+    int usedSlots = 0;
+    std::vector<uint32_t> changedTiles;
+    std::vector<float> staging;
+    const DepositionGrid* uploadedGrid = nullptr;
+    uint64_t uploadedVersion = 0;
+    uint64_t uploadedGeneration = 0;
+    // The dense texture need not match the window
+    GLint savedViewport[4] = {};
+
+    void allocate(unsigned int width, unsigned int height);
+    void resetSparse(const DepositionGrid& grid);
+    void growAtlas(int neededSlots);
+    void release();
 };
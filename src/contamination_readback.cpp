@@ -0,0 +1,69 @@
+#include "contamination_readback.hpp"
+#include "world_constraints.hpp"
+
+#include <cstring>
+
+ContaminationReadback::~ContaminationReadback() {
+    for (Slot& slot : slots) {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+        if (slot.pbo)
+            glDeleteBuffers(1, &slot.pbo);
+    }
+}
+
+bool ContaminationReadback::request(const Contamination& mask, double time) {
+    if (inFlight == ringSize)
+        return false;
+
+    Slot& slot = slots[(oldest + inFlight) % ringSize];
+    slot.cellCount = static_cast<size_t>(mask.getWidth()) * mask.getHeight();
+    slot.cellArea = (WorldConstraints::MAP_RIGHT - WorldConstraints::MAP_LEFT) *
+                    (WorldConstraints::MAP_BOTTOM - WorldConstraints::MAP_TOP) / slot.cellCount;
+    slot.time = time;
+
+    if (!slot.pbo)
+        glGenBuffers(1, &slot.pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    if (slot.capacity != slot.cellCount * sizeof(float)) {
+        slot.capacity = slot.cellCount * sizeof(float);
+        glBufferData(GL_PIXEL_PACK_BUFFER, slot.capacity, nullptr, GL_STREAM_READ);
+    }
+
+    // With a pack buffer bound the pointer is an offset and the call returns
+    // as soon as the copy is queued
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, mask.getFramebuffer());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glReadPixels(0, 0, mask.getWidth(), mask.getHeight(), GL_RED, GL_FLOAT, nullptr);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    ++inFlight;
+    return true;
+}
+
+void ContaminationReadback::poll(ContaminationStats& stats) {
+    while (inFlight > 0) {
+        Slot& slot = slots[oldest];
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+            return;
+
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        const void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.capacity, GL_MAP_READ_BIT);
+        if (data) {
+            cells.resize(slot.cellCount);
+            std::memcpy(cells.data(), data, slot.capacity);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            stats.submit(std::move(cells), slot.cellArea, slot.time);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        oldest = (oldest + 1) % ringSize;
+        --inFlight;
+    }
+}
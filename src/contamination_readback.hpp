@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/glad.h>
+
+#include <vector>
+
+#include "contamination.hpp"
+#include "contamination_stats.hpp"
+
+// Reads the dense contamination texture back without stalling the frame. A
+// request starts an asynchronous glReadPixels into one of a ring of pixel
+// buffers and fences it; a later poll hands every copy whose fence has passed
+// to ContaminationStats. If every buffer is still in flight the request is
+// skipped rather than waited for.
+class ContaminationReadback {
+public:
+    static constexpr int ringSize = 3;
+
+    ~ContaminationReadback();
+
+    // Returns false if no buffer was free
+    bool request(const Contamination& mask, double time);
+    // Never waits; copies out of finished buffers only
+    void poll(ContaminationStats& stats);
+
+private:
+    struct Slot {
+        GLuint pbo = 0;
+        GLsync fence = nullptr;
+        size_t capacity = 0; // bytes
+        size_t cellCount = 0;
+        float cellArea = 0.0f;
+        double time = 0.0;
+    };
+
+    Slot slots[ringSize];
+    int oldest = 0; // next slot to complete
+    int inFlight = 0;
+    std::vector<float> cells;
+};
@@ -0,0 +1,105 @@
+#include "contamination_stats.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+ContaminationSummary ContaminationSummary::compute(const float* cells, size_t count, float cellArea) {
+    ContaminationSummary summary;
+    size_t low = 0, mid = 0, high = 0;
+    double total = 0.0;
+    float max = 0.0f;
+
+    for (size_t i = 0; i < count; ++i) {
+        const float value = cells[i];
+        total += value;
+        max = std::max(max, value);
+        low += value > lowThreshold && value <= midThreshold;
+        mid += value > midThreshold && value <= highThreshold;
+        high += value > highThreshold;
+    }
+
+    summary.lowArea = low * static_cast<double>(cellArea);
+    summary.midArea = mid * static_cast<double>(cellArea);
+    summary.highArea = high * static_cast<double>(cellArea);
+    summary.total = total * cellArea;
+    summary.max = max;
+    return summary;
+}
+
+ContaminationStats::ContaminationStats() {
+    worker = std::thread(&ContaminationStats::run, this);
+}
+
+ContaminationStats::~ContaminationStats() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    worker.join();
+}
+
+void ContaminationStats::submit(std::vector<float>&& cells, float cellArea, double time) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending.cells.swap(cells);
+        pending.cellArea = cellArea;
+        pending.time = time;
+        hasPending = true;
+    }
+    wakeUp.notify_one();
+}
+
+ContaminationSummary ContaminationStats::getLatest() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return latest;
+}
+
+bool ContaminationStats::setSink(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (sink.is_open())
+        sink.close();
+    if (path.empty())
+        return true;
+
+    sink.open(path, std::ios::out | std::ios::trunc);
+    if (!sink) {
+        std::cerr << "[ContaminationStats] ERROR: cannot open " << path << "\n";
+        return false;
+    }
+    sink << "sequence,time,low_area,mid_area,high_area,total,max\n";
+    return true;
+}
+
+bool ContaminationStats::hasSink() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sink.is_open();
+}
+
+void ContaminationStats::run() {
+    Job job;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wakeUp.wait(lock, [this] { return stopping || hasPending; });
+            if (stopping)
+                return;
+
+            std::swap(job, pending);
+            hasPending = false;
+        }
+
+        ContaminationSummary summary = ContaminationSummary::compute(job.cells.data(), job.cells.size(), job.cellArea);
+        summary.time = job.time;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        summary.sequence = ++sequence;
+        latest = summary;
+        if (sink.is_open()) {
+            sink << summary.sequence << ',' << summary.time << ','
+                 << summary.lowArea << ',' << summary.midArea << ',' << summary.highArea << ','
+                 << summary.total << ',' << summary.max << '\n';
+        }
+    }
+}
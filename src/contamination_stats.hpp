@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Summary of a contamination field, in the bands the plane shader colours
+struct ContaminationSummary {
+    static constexpr float lowThreshold = 0.001f;
+    static constexpr float midThreshold = 0.2f;
+    static constexpr float highThreshold = 0.7f;
+
+    uint64_t sequence = 0; // 0 until a first summary is ready
+    double time = 0.0;
+    double lowArea = 0.0;  // map units^2 in (low, mid]
+    double midArea = 0.0;  // in (mid, high]
+    double highArea = 0.0; // above high
+    double total = 0.0;    // deposited amount, cells times cell area
+    float max = 0.0f;
+
+    double getContaminatedArea() const { return lowArea + midArea + highArea; }
+
+    static ContaminationSummary compute(const float* cells, size_t count, float cellArea);
+};
+
+// Computes ContaminationSummary on a worker thread so whoever collects the
+// cells never waits for the statistics. Submissions arriving while the worker
+// is busy replace each other; only the newest is summarised. Every summary can
+// also be appended to a CSV file.
+class ContaminationStats {
+public:
+    ContaminationStats();
+    ~ContaminationStats();
+
+    ContaminationStats(const ContaminationStats&) = delete;
+    ContaminationStats& operator=(const ContaminationStats&) = delete;
+
+    // Takes the cells over and leaves an earlier buffer in their place to be
+    // reused. Layout does not matter, only values and cell area.
+    void submit(std::vector<float>&& cells, float cellArea, double time);
+    ContaminationSummary getLatest() const;
+
+    // Empty path closes the sink. Returns false if the file cannot be opened.
+    bool setSink(const std::string& path);
+    bool hasSink() const;
+
+private:
+    struct Job {
+        std::vector<float> cells;
+        float cellArea = 0.0f;
+        double time = 0.0;
+    };
+
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable wakeUp;
+    Job pending;
+    bool hasPending = false;
+    bool stopping = false;
+
+    ContaminationSummary latest;
+    uint64_t sequence = 0;
+    std::ofstream sink;
+
+    void run();
+};
@@ -0,0 +1,117 @@
+#include "cpu_particle_system.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+CpuParticleSystem::~CpuParticleSystem() {
+    if (!vao)
+        return;
+
+    for (GLsync fence : ringFences) {
+        if (fence)
+            glDeleteSync(fence);
+    }
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteBuffers(1, &vboInstance);
+}
+
+void CpuParticleSystem::initialize() {
+    float quadVerts[] = {
+        -0.5f, -0.5f,
+         0.5f, -0.5f,
+        -0.5f,  0.5f,
+         0.5f,  0.5f
+    };
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVerts), quadVerts, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+
+    glGenBuffers(1, &vboInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, vboInstance);
+
+    glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * maxParticles * instanceRingSize, NULL, GL_STREAM_DRAW);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    bindInstanceAttributes(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+// Points the per-instance attributes at the ring slot starting at byte offset base.
+// Expects the VAO and the instance buffer to be bound.
+void CpuParticleSystem::bindInstanceAttributes(size_t base) {
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(base + offsetof(InstanceData, pos)));
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(base + offsetof(InstanceData, intensity)));
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)(base + offsetof(InstanceData, scale)));
+}
+
+// The simulation thread steps on its own clock, with the wind it was started with
+void CpuParticleSystem::update(float, const WindGrid&) {
+    snapshot = &simulationThread.acquireSnapshot();
+}
+
+// Writes this frame's instances into the next slot of the instance ring. Slots
+// are mapped unsynchronized; the fence guarding a slot was inserted three frames
+// earlier, so waiting on it practically never blocks. Call once per frame before
+// any draw().
+void CpuParticleSystem::prepareInstances() {
+    // Every draw reading the current slot has been issued by now
+    if (instanceCount > 0)
+        ringFences[ringSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    ringSlot = (ringSlot + 1) % instanceRingSize;
+    if (ringFences[ringSlot]) {
+        glClientWaitSync(ringFences[ringSlot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(ringFences[ringSlot]);
+        ringFences[ringSlot] = nullptr;
+    }
+
+    instanceCount = snapshot ? std::min(snapshot->size(), maxParticles) : 0;
+    size_t base = ringSlot * maxParticles * sizeof(InstanceData);
+
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vboInstance);
+
+    if (instanceCount > 0) {
+        void *mapped = glMapBufferRange(GL_ARRAY_BUFFER, base, instanceCount * sizeof(InstanceData),
+                                        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped) {
+            InstanceData *instances = static_cast<InstanceData *>(mapped);
+            const float alpha = simulationThread.getInterpolationFactor(*snapshot);
+            for (size_t i = 0; i < instanceCount; ++i) {
+                instances[i] = { snapshot->interpolate(i, alpha), snapshot->intensity[i], snapshot->scale[i] };
+            }
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+        }
+        else {
+            std::cerr << "[CpuParticleSystem] ERROR: failed to map instance buffer\n";
+            instanceCount = 0;
+        }
+    }
+
+    bindInstanceAttributes(base);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void CpuParticleSystem::draw() {
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instanceCount);
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+}
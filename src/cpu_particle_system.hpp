@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "particle_backend.hpp"
+#include "particle_system.hpp"
+#include "simulation_thread.hpp"
+
+// Draws a ParticleSystem simulated on the CPU. The simulation runs on its own
+// thread at a fixed step; each frame the newest snapshot is interpolated to
+// the current time, copied into a ring of instance buffers and drawn as
+// instanced quads. Contamination comes from the thread's deposition grid.
+class CpuParticleSystem : public ParticleBackend {
+public:
+    explicit CpuParticleSystem(size_t maxParticles = 50000) : simulationThread(maxParticles), maxParticles(maxParticles) {}
+    ~CpuParticleSystem();
+
+    void initialize() override;
+    void release(const glm::vec3& sourcePos, int powerMW, const ReleaseProfile& profile) override {
+        simulationThread.release(sourcePos, powerMW, profile);
+    }
+    // The simulation advances on its own; this only picks up its newest state
+    void update(float deltaTime, const WindGrid& windGrid) override;
+    void prepareInstances() override;
+    void draw() override;
+    // Only while the simulation thread is stopped
+    void setSeed(uint64_t seed) override {
+        simulationThread.getSimulation().setSeed(seed);
+        simulationThread.getScheduler().setSeed(seed);
+    }
+
+    size_t size() override { return snapshot ? snapshot->size() : 0; }
+    const char* getName() const override { return "CPU particles"; }
+    DepositionGrid* getDeposition() override { return &simulationThread.getDeposition(); }
+
+    // Starts stepping the particles through windGrid, see SimulationThread::start
+    void start(const WindGrid& windGrid) { simulationThread.start(windGrid); }
+    ParticleSystem& getSimulation() { return simulationThread.getSimulation(); }
+    SimulationThread& getSimulationThread() { return simulationThread; }
+    const ParticleSnapshot* getSnapshot() const { return snapshot; }
+
+private:
+    SimulationThread simulationThread;
+    const ParticleSnapshot* snapshot = nullptr;
+    const size_t maxParticles;
+
+    GLuint vao = 0;
+    GLuint vboInstance = 0;
+    GLuint quadVBO = 0;
+
+    // The instance buffer holds instanceRingSize slots of maxParticles each and
+    // every frame writes the next one, so the CPU never overwrites data the GPU
+    // may still be reading.
+    static constexpr size_t instanceRingSize = 3;
+    size_t ringSlot = 0;
+    size_t instanceCount = 0;
+    GLsync ringFences[instanceRingSize] = {};
+
+    void bindInstanceAttributes(size_t base);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+// Collects the per-frame factors of a radioactive decay until together they
+// make a step a half-float value can hold. Long half-lives give factors
+// within a millionth of 1, which an R16F texel, with 11 significant bits,
+// rounds straight back to the value it started from, so multiplying them in
+// one frame at a time would never decay anything.
+struct DecayAccumulator {
+    // Far above the 1/2048 rounding step of a half, so that rounding each
+    // application barely shifts the overall rate
+    static constexpr double minStep = 1.0 / 128.0;
+
+    double pending = 1.0;
+
+    // Adds a frame's factor and returns the factor to apply now: everything
+    // gathered so far once it is minStep below 1, otherwise 1
+    float take(double factor) {
+        pending *= factor;
+        if (pending > 1.0 - minStep)
+            return 1.0f;
+
+        float step = static_cast<float>(pending);
+        pending = 1.0;
+        return step;
+    }
+
+    void reset() { pending = 1.0; }
+};
@@ -0,0 +1,284 @@
+#include "deposition_grid.hpp"
+#include "world_constraints.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+DepositionGrid::DepositionGrid(int width, int height) : width(width), height(height) {
+    cellSize = glm::vec2((WorldConstraints::MAP_RIGHT - WorldConstraints::MAP_LEFT) / width,
+                         (WorldConstraints::MAP_BOTTOM - WorldConstraints::MAP_TOP) / height);
+    tilesX = (width + tileSize - 1) / tileSize;
+    tilesZ = (height + tileSize - 1) / tileSize;
+    tiles.pages.resize(static_cast<size_t>(tilesX) * tilesZ);
+    changed.assign(tiles.pages.size(), 0);
+}
+
+float* DepositionGrid::touchTile(size_t tile) {
+    changed[tile] = 1;
+    return tiles.touch(tile);
+}
+
+// Calls writeRow(cells, row, x0, x1) for every row of [x0, x1) x [z0, z1)
+// within each tile the rectangle overlaps, cells pointing at column x0 of the
+// row. Tiles of the grid itself are flagged as changed.
+template <typename WriteRow>
+void DepositionGrid::forEachRowSpan(TileStore* target, int x0, int x1, int z0, int z1, WriteRow writeRow) {
+    for (int tileZ = z0 / tileSize; tileZ <= (z1 - 1) / tileSize; ++tileZ) {
+        const int rowBegin = std::max(z0, tileZ * tileSize);
+        const int rowEnd = std::min(z1, (tileZ + 1) * tileSize);
+
+        for (int tileX = x0 / tileSize; tileX <= (x1 - 1) / tileSize; ++tileX) {
+            const int colBegin = std::max(x0, tileX * tileSize);
+            const int colEnd = std::min(x1, (tileX + 1) * tileSize);
+            const size_t tile = static_cast<size_t>(tileZ) * tilesX + tileX;
+
+            float* page = target->touch(tile);
+            if (target == &tiles)
+                changed[tile] = 1;
+
+            for (int row = rowBegin; row < rowEnd; ++row)
+                writeRow(&page[(row - tileZ * tileSize) * tileSize + (colBegin - tileX * tileSize)], row, colBegin, colEnd);
+        }
+    }
+}
+
+void DepositionGrid::deposit(const ParticleData& particles, float deltaTime) {
+    const size_t count = particles.size();
+    const size_t slices = threadPool ? std::min<size_t>(threadPool->getThreadCount(), (count + 1023) / 1024) : 1;
+
+    if (slices <= 1) {
+        std::lock_guard<std::mutex> guard(mutex);
+        depositSlice(particles, 0, count, deltaTime, &tiles);
+        markChanged();
+        // Too few particles left to split; drop the slices' pages
+        if (!sliceTiles.empty()) {
+            sliceTiles.clear();
+            slicePages.store(0, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    while (sliceTiles.size() < slices) {
+        sliceTiles.emplace_back();
+        sliceTiles.back().pages.resize(tiles.pages.size());
+    }
+
+    const size_t perSlice = (count + slices - 1) / slices;
+    threadPool->parallelFor(slices, [&](size_t slice) {
+        size_t begin = slice * perSlice;
+        size_t end = std::min(begin + perSlice, count);
+        depositSlice(particles, begin, end, deltaTime, &sliceTiles[slice]);
+    });
+
+    // Each tile sums the slices that wrote to it and zeroes their copies
+    std::unique_lock<std::mutex> guard(mutex);
+    threadPool->parallelFor(tiles.pages.size(), [&](size_t tile) {
+        for (size_t slice = 0; slice < slices; ++slice) {
+            float* source = sliceTiles[slice].pages[tile].get();
+            if (!source)
+                continue;
+
+            float* cells = touchTile(tile);
+            for (size_t i = 0; i < tileCells; ++i)
+                cells[i] += source[i];
+            std::fill(source, source + tileCells, 0.0f);
+        }
+    });
+    markChanged();
+    guard.unlock();
+
+    // The zeroed pages become each slice's spares for the next step, and
+    // whatever it left spare this step is freed
+    size_t pages = 0;
+    for (TileStore& store : sliceTiles) {
+        store.spare.clear();
+        for (auto& page : store.pages) {
+            if (page)
+                store.spare.push_back(std::move(page));
+        }
+        pages += store.spare.size();
+    }
+    slicePages.store(pages, std::memory_order_relaxed);
+}
+
+// Adds particles [begin, end) to the tiles of target.
+void DepositionGrid::depositSlice(const ParticleData& particles, size_t begin, size_t end, float deltaTime, TileStore* target) {
+    for (size_t i = begin; i < end; ++i) {
+        float amount = std::min(particles.intensity[i], 1.0f) * deltaTime;
+        if (amount <= 0.0f)
+            continue;
+
+        float half = 0.5f * particles.scale[i];
+        float x = particles.positionX[i] - WorldConstraints::MAP_LEFT;
+        float z = WorldConstraints::MAP_BOTTOM - particles.positionZ[i];
+
+        // Cells whose centres lie inside the quad, as the rasterizer would pick them
+        int x0 = std::max(static_cast<int>(std::ceil((x - half) / cellSize.x - 0.5f)), 0);
+        int x1 = std::min(static_cast<int>(std::ceil((x + half) / cellSize.x - 0.5f)), width);
+        int z0 = std::max(static_cast<int>(std::ceil((z - half) / cellSize.y - 0.5f)), 0);
+        int z1 = std::min(static_cast<int>(std::ceil((z + half) / cellSize.y - 0.5f)), height);
+        if (x0 >= x1 || z0 >= z1)
+            continue;
+
+        // Most quads fall inside a single tile
+        const int tileX = x0 / tileSize, tileZ = z0 / tileSize;
+        if (tileX == (x1 - 1) / tileSize && tileZ == (z1 - 1) / tileSize) {
+            const size_t tile = static_cast<size_t>(tileZ) * tilesX + tileX;
+            float* cells = target->pages[tile] ? target->pages[tile].get() : target->touch(tile);
+            cells += (z0 - tileZ * tileSize) * tileSize + (x0 - tileX * tileSize);
+            if (target == &tiles)
+                changed[tile] = 1;
+
+            for (int row = z0; row < z1; ++row, cells += tileSize) {
+                for (int col = 0; col < x1 - x0; ++col)
+                    cells[col] += amount;
+            }
+            continue;
+        }
+
+        forEachRowSpan(target, x0, x1, z0, z1, [amount](float* cells, int, int colBegin, int colEnd) {
+            for (int col = 0; col < colEnd - colBegin; ++col)
+                cells[col] += amount;
+        });
+    }
+}
+
+// The Gaussian is separable, so it is evaluated once per column and once per
+// row and every cell only multiplies the two.
+void DepositionGrid::depositGaussian(glm::vec2 centre, float sigma, float amount) {
+    if (sigma <= 0.0f || amount <= 0.0f)
+        return;
+
+    float x = centre.x - WorldConstraints::MAP_LEFT;
+    float z = WorldConstraints::MAP_BOTTOM - centre.y;
+    float reach = 3.0f * sigma;
+
+    int x0 = std::max(static_cast<int>(std::ceil((x - reach) / cellSize.x - 0.5f)), 0);
+    int x1 = std::min(static_cast<int>(std::ceil((x + reach) / cellSize.x - 0.5f)), width);
+    int z0 = std::max(static_cast<int>(std::ceil((z - reach) / cellSize.y - 0.5f)), 0);
+    int z1 = std::min(static_cast<int>(std::ceil((z + reach) / cellSize.y - 0.5f)), height);
+    if (x0 >= x1 || z0 >= z1)
+        return;
+
+    // Density of the normalised 1D Gaussian at each cell centre
+    const float inverseTwoVariance = 1.0f / (2.0f * sigma * sigma);
+    const float normalisation = 1.0f / (std::sqrt(2.0f * glm::pi<float>()) * sigma);
+
+    weightsX.resize(x1 - x0);
+    for (int col = x0; col < x1; ++col) {
+        float d = (col + 0.5f) * cellSize.x - x;
+        weightsX[col - x0] = normalisation * std::exp(-d * d * inverseTwoVariance);
+    }
+    weightsZ.resize(z1 - z0);
+    for (int row = z0; row < z1; ++row) {
+        float d = (row + 0.5f) * cellSize.y - z;
+        weightsZ[row - z0] = amount * normalisation * std::exp(-d * d * inverseTwoVariance);
+    }
+
+    std::lock_guard<std::mutex> guard(mutex);
+    forEachRowSpan(&tiles, x0, x1, z0, z1, [&](float* cells, int row, int colBegin, int colEnd) {
+        const float weightZ = weightsZ[row - z0];
+        const float* weights = &weightsX[colBegin - x0];
+        for (int col = 0; col < colEnd - colBegin; ++col)
+            cells[col] += weightZ * weights[col];
+    });
+    markChanged();
+}
+
+void DepositionGrid::clear() {
+    std::lock_guard<std::mutex> guard(mutex);
+    pendingDecay.reset();
+    for (auto& page : tiles.pages)
+        page.reset();
+    std::fill(changed.begin(), changed.end(), 0);
+    generation.fetch_add(1, std::memory_order_release);
+    markChanged();
+}
+
+void DepositionGrid::decay(double factor) {
+    std::lock_guard<std::mutex> guard(mutex);
+    const float step = pendingDecay.take(factor);
+    if (step == 1.0f)
+        return;
+
+    for (size_t tile = 0; tile < tiles.pages.size(); ++tile) {
+        float* cells = tiles.pages[tile].get();
+        if (!cells)
+            continue;
+
+        bool nonzero = false;
+        for (size_t i = 0; i < tileCells; ++i) {
+            cells[i] *= step;
+            nonzero |= cells[i] != 0.0f;
+        }
+        if (nonzero)
+            changed[tile] = 1;
+    }
+    markChanged();
+}
+
+void DepositionGrid::takeChangedTiles(std::vector<uint32_t>& tileIndices, std::vector<float>& cells, bool all) const {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (size_t tile = 0; tile < tiles.pages.size(); ++tile) {
+        const float* page = tiles.pages[tile].get();
+        if (!page || !(all || changed[tile]))
+            continue;
+
+        changed[tile] = 0;
+        tileIndices.push_back(static_cast<uint32_t>(tile));
+        cells.insert(cells.end(), page, page + tileCells);
+    }
+}
+
+void DepositionGrid::copyCells(std::vector<float>& cells) const {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (const auto& page : tiles.pages) {
+        if (page)
+            cells.insert(cells.end(), page.get(), page.get() + tileCells);
+    }
+}
+
+float DepositionGrid::getValue(int col, int row) const {
+    if (col < 0 || col >= width || row < 0 || row >= height)
+        return 0.0f;
+
+    const float* page = tiles.pages[static_cast<size_t>(row / tileSize) * tilesX + col / tileSize].get();
+    return page ? page[(row % tileSize) * tileSize + col % tileSize] : 0.0f;
+}
+
+// Cells of edge tiles past the grid's width or height are never written, so
+// whole tiles can be summed.
+float DepositionGrid::getTotal() const {
+    double total = 0.0;
+    for (const auto& page : tiles.pages) {
+        if (!page)
+            continue;
+        for (size_t i = 0; i < tileCells; ++i)
+            total += page[i];
+    }
+    return static_cast<float>(total * cellSize.x * cellSize.y);
+}
+
+float DepositionGrid::getMax() const {
+    float max = 0.0f;
+    for (const auto& page : tiles.pages) {
+        if (page)
+            max = std::max(max, *std::max_element(page.get(), page.get() + tileCells));
+    }
+    return max;
+}
+
+size_t DepositionGrid::countAbove(float threshold) const {
+    size_t count = 0;
+    for (const auto& page : tiles.pages) {
+        if (page)
+            count += std::count_if(page.get(), page.get() + tileCells, [threshold](float value) { return value > threshold; });
+    }
+    return count;
+}
+
+size_t DepositionGrid::getAllocatedTiles() const {
+    return std::count_if(tiles.pages.begin(), tiles.pages.end(), [](const auto& page) { return page != nullptr; });
+}
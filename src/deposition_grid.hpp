@@ -0,0 +1,138 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "decay_accumulator.hpp"
+#include "particle_system.hpp"
+#include "thread_pool.hpp"
+
+// Contamination deposited on the ground, accumulated on the CPU from particle
+// positions. Every particle adds its intensity (clamped to 1) times deltaTime
+// to the cells under its quad, so the result does not depend on the frame
+// rate. Cells cover the map extent with row 0 at MAP_BOTTOM, the same layout
+// as the contamination texture.
+//
+// Cells are stored in square tiles that are only allocated once something is
+// deposited in them, so memory follows the contaminated area and the grid can
+// be made much finer than the map is large. A page table holds one pointer per
+// tile, null for tiles that are still clean.
+//
+// With a thread pool, particles are split into slices that each write into a
+// private set of tiles; the tiles are then summed into the grid in parallel,
+// tile by tile, and kept zeroed for the slice's next step.
+//
+// The grid may be read from another thread than the one depositing: writes to
+// the values happen under lock(), and the version changes after every write
+// so readers can skip unchanged grids. Tiles written since the last
+// takeChangedTiles() are flagged so a reader copies only those.
+class DepositionGrid {
+public:
+    static constexpr int tileSize = 64;
+    static constexpr size_t tileCells = static_cast<size_t>(tileSize) * tileSize;
+
+    DepositionGrid(int width = 1200, int height = 800);
+
+    DepositionGrid(const DepositionGrid&) = delete;
+    DepositionGrid& operator=(const DepositionGrid&) = delete;
+
+    void deposit(const ParticleData& particles, float deltaTime);
+    // Spreads amount over a 2D Gaussian around centre (x, z), cut off at 3 sigma
+    void depositGaussian(glm::vec2 centre, float sigma, float amount);
+    // Frees every tile
+    void clear();
+    // Multiplies every cell by factor, e.g. for radioactive decay. Factors
+    // too close to 1 to show in a half-float copy of the grid are gathered
+    // over several calls, so values may trail the exact decay by up to
+    // DecayAccumulator::minStep and only tiles holding something change.
+    void decay(double factor);
+    void setThreadPool(ThreadPool* pool) { threadPool = pool; }
+
+    // Cells of a tile, tileSize rows of tileSize, allocated on first use and
+    // flagged as changed. Writers going through this hold lock() and call
+    // markChanged() when done; the other writes do both themselves. Different
+    // tiles may be touched from different threads at once.
+    float* touchTile(size_t tile);
+    void markChanged() { version.fetch_add(1, std::memory_order_release); }
+    uint64_t getVersion() const { return version.load(std::memory_order_acquire); }
+    // Changes when clear() drops the tiles, which a reader then drops as well
+    uint64_t getGeneration() const { return generation.load(std::memory_order_acquire); }
+    std::unique_lock<std::mutex> lock() const { return std::unique_lock<std::mutex>(mutex); }
+
+    // Appends the indices and cells of the tiles changed since the last call,
+    // or of every allocated tile if all is set, and clears their flags. Takes
+    // the lock itself.
+    void takeChangedTiles(std::vector<uint32_t>& tileIndices, std::vector<float>& cells, bool all) const;
+    // Appends the cells of every allocated tile, in no particular layout, for
+    // statistics over the whole grid. Takes the lock itself.
+    void copyCells(std::vector<float>& cells) const;
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    int getTilesX() const { return tilesX; }
+    int getTilesZ() const { return tilesZ; }
+    glm::vec2 getCellSize() const { return cellSize; }
+    // Null for a tile nothing was deposited in
+    const float* getTile(size_t tile) const { return tiles.pages[tile].get(); }
+    float getValue(int col, int row) const;
+
+    float getTotal() const;
+    float getMax() const;
+    size_t countAbove(float threshold) const;
+    size_t getAllocatedTiles() const;
+    // Tiles of the grid and those the slices keep for their next step
+    size_t getMemoryBytes() const {
+        return (getAllocatedTiles() + slicePages.load(std::memory_order_relaxed)) * tileCells * sizeof(float);
+    }
+
+private:
+    struct TileStore {
+        std::vector<std::unique_ptr<float[]>> pages;
+        // Zeroed pages to hand out before allocating new ones
+        std::vector<std::unique_ptr<float[]>> spare;
+
+        float* touch(size_t tile) {
+            if (!pages[tile]) {
+                if (spare.empty()) {
+                    pages[tile].reset(new float[tileCells]());
+                }
+                else {
+                    pages[tile] = std::move(spare.back());
+                    spare.pop_back();
+                }
+            }
+            return pages[tile].get();
+        }
+    };
+
+    TileStore tiles;
+    mutable std::vector<uint8_t> changed; // reader bookkeeping, see takeChangedTiles()
+    int width;
+    int height;
+    int tilesX = 0;
+    int tilesZ = 0;
+    glm::vec2 cellSize;
+    std::vector<float> weightsX, weightsZ;
+
+    ThreadPool* threadPool = nullptr;
+    mutable std::mutex mutex;
+    std::atomic<uint64_t> version{ 0 };
+    std::atomic<uint64_t> generation{ 0 };
+    DecayAccumulator pendingDecay;
+
+    // Private tiles of every slice. After each merge a slice keeps as many
+    // zeroed pages as it last used, so memory follows the plume's current
+    // footprint rather than everything it ever covered.
+    std::vector<TileStore> sliceTiles;
+    std::atomic<size_t> slicePages{ 0 };
+
+    void depositSlice(const ParticleData& particles, size_t begin, size_t end, float deltaTime, TileStore* target);
+    template <typename WriteRow>
+    void forEachRowSpan(TileStore* target, int x0, int x1, int z0, int z1, WriteRow writeRow);
+};
@@ -0,0 +1,91 @@
+#include "emission_scheduler.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+ReleaseProfile ReleaseProfile::instant(uint64_t total) {
+    return { total, { glm::vec2(0.0f, 1.0f) } };
+}
+
+ReleaseProfile ReleaseProfile::constant(uint64_t total, float duration) {
+    if (duration <= 0.0f)
+        return instant(total);
+    return { total, { glm::vec2(0.0f, 1.0f), glm::vec2(duration, 1.0f) } };
+}
+
+ReleaseProfile ReleaseProfile::decaying(uint64_t total, float halfLife, float duration) {
+    if (duration <= 0.0f || halfLife <= 0.0f)
+        return instant(total);
+
+    const int segments = 32;
+    ReleaseProfile profile{ total, {} };
+    for (int i = 0; i <= segments; ++i) {
+        float t = duration * i / segments;
+        profile.rate.push_back(glm::vec2(t, std::exp2(-t / halfLife)));
+    }
+    return profile;
+}
+
+double ReleaseProfile::getReleasedFraction(double t) const {
+    if (t < 0.0)
+        return 0.0;
+    if (rate.size() < 2 || t >= getDuration())
+        return 1.0;
+
+    // Area under the rate up to t over the area under all of it
+    double released = 0.0, overall = 0.0;
+    for (size_t i = 1; i < rate.size(); ++i) {
+        const glm::vec2 &a = rate[i - 1], &b = rate[i];
+        overall += 0.5 * (a.y + b.y) * (b.x - a.x);
+
+        if (t > a.x) {
+            double end = std::min(t, static_cast<double>(b.x));
+            double rateAtEnd = b.x > a.x ? a.y + (b.y - a.y) * (end - a.x) / (b.x - a.x) : b.y;
+            released += 0.5 * (a.y + rateAtEnd) * (end - a.x);
+        }
+    }
+    return overall > 0.0 ? std::clamp(released / overall, 0.0, 1.0) : 1.0;
+}
+
+uint64_t EmissionScheduler::Release::getDue() const {
+    uint64_t released = static_cast<uint64_t>(std::floor(profile.total * profile.getReleasedFraction(elapsed)));
+    return released > emitted ? released - emitted : 0;
+}
+
+void EmissionScheduler::schedule(const glm::vec3& sourcePos, float powerMW, const ReleaseProfile& profile,
+                                 size_t maxParticles) {
+    if (profile.total == 0)
+        return;
+
+    EmissionParams params = ParticleEmission::computeParams(powerMW, maxParticles);
+    releases.push_back({ sourcePos, params, profile, sequence.seed, sequence.next(), 0, 0.0 });
+}
+
+const std::vector<EmissionBatch>& EmissionScheduler::collectDue(float deltaTime, size_t available) {
+    batches.clear();
+    size_t remaining = std::min(budget, available);
+
+    for (Release& release : releases) {
+        release.elapsed += deltaTime;
+
+        size_t count = static_cast<size_t>(std::min<uint64_t>(release.getDue(), remaining));
+        if (count == 0)
+            continue;
+
+        batches.push_back({ release.sourcePos, release.params, release.seed, release.emission, release.emitted, count });
+        release.emitted += count;
+        remaining -= count;
+    }
+
+    releases.erase(std::remove_if(releases.begin(), releases.end(),
+                                  [](const Release& release) { return release.emitted >= release.profile.total; }),
+                   releases.end());
+    return batches;
+}
+
+uint64_t EmissionScheduler::getBacklog() const {
+    uint64_t backlog = 0;
+    for (const Release& release : releases)
+        backlog += release.getDue();
+    return backlog;
+}
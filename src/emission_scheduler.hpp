@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "particle_emission.hpp"
+
+// How a release spreads over time: a total particle count and a relative
+// release rate, linear between the given points. Only the shape of the rate
+// matters, it is normalised so the whole release adds up to total.
+struct ReleaseProfile {
+    uint64_t total = 0;
+    std::vector<glm::vec2> rate; // (seconds since the release started, relative rate)
+
+    // Everything at once, as a single explosion
+    static ReleaseProfile instant(uint64_t total);
+    // Same rate from start to end
+    static ReleaseProfile constant(uint64_t total, float duration);
+    // Rate halving every halfLife seconds, cut off after duration
+    static ReleaseProfile decaying(uint64_t total, float halfLife, float duration);
+
+    float getDuration() const { return rate.empty() ? 0.0f : rate.back().x; }
+    // Share of the total released by time t, in [0, 1]. Takes t in double,
+    // as a float counting seconds no longer advances by a frame's time once a
+    // release has run for a few days.
+    double getReleasedFraction(double t) const;
+};
+
+// A run of consecutive particles of one emission, ready to be sampled with
+// ParticleEmission::sample.
+struct EmissionBatch {
+    glm::vec3 sourcePos;
+    EmissionParams params;
+    uint64_t seed;
+    uint64_t emission;
+    uint64_t firstIndex;
+    size_t count;
+};
+
+// Spreads releases over simulation steps. Each step hands out the particles
+// that have come due, oldest release first, but never more than the budget,
+// so a large release costs a few steps of bounded work instead of one long
+// one. Whatever does not fit stays due for later steps. Particle i of a
+// release is the same particle whichever step creates it.
+class EmissionScheduler {
+public:
+    static constexpr size_t defaultBudget = 2000;
+
+    void schedule(const glm::vec3& sourcePos, float powerMW, const ReleaseProfile& profile, size_t maxParticles);
+    // Advances every release by deltaTime and returns the batches to emit now,
+    // at most min(budget, available) particles in total
+    const std::vector<EmissionBatch>& collectDue(float deltaTime, size_t available);
+
+    void setSeed(uint64_t seed) { sequence = { seed, 0 }; }
+    void setBudget(size_t perStep) { budget = perStep; }
+    size_t getBudget() const { return budget; }
+
+    bool empty() const { return releases.empty(); }
+    size_t getActiveReleases() const { return releases.size(); }
+    // Particles that are due but have not been handed out yet
+    uint64_t getBacklog() const;
+
+private:
+    struct Release {
+        glm::vec3 sourcePos;
+        EmissionParams params;
+        ReleaseProfile profile;
+        uint64_t seed;
+        uint64_t emission;
+        uint64_t emitted;
+        double elapsed;
+
+        uint64_t getDue() const;
+    };
+
+    std::vector<Release> releases;
+    std::vector<EmissionBatch> batches;
+    EmissionSequence sequence;
+    size_t budget = defaultBudget;
+};
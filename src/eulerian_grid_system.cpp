@@ -0,0 +1,34 @@
+#include "eulerian_grid_system.hpp"
+
+#include <cmath>
+#include <limits>
+
+EulerianGridSystem::EulerianGridSystem() {
+    // The grid takes on any amount of material in constant time
+    scheduler.setBudget(std::numeric_limits<size_t>::max());
+}
+
+void EulerianGridSystem::release(const glm::vec3 &sourcePos, int powerMW, const ReleaseProfile &profile) {
+    scheduler.schedule(sourcePos, powerMW, profile, std::numeric_limits<size_t>::max());
+}
+
+void EulerianGridSystem::update(float deltaTime, const WindGrid &windGrid) {
+    accumulator += deltaTime;
+
+    int steps = 0;
+    while (accumulator >= timeStep && steps < maxStepsPerFrame) {
+        for (const EmissionBatch &batch : scheduler.collectDue(timeStep, std::numeric_limits<size_t>::max()))
+            solver.emit(batch);
+
+        solver.update(timeStep, windGrid);
+        accumulator -= timeStep;
+        ++steps;
+    }
+
+    if (steps == maxStepsPerFrame)
+        accumulator = 0.0f;
+}
+
+size_t EulerianGridSystem::size() {
+    return static_cast<size_t>(std::llround(solver.getAirborneMass()));
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "emission_scheduler.hpp"
+#include "eulerian_solver.hpp"
+#include "particle_backend.hpp"
+
+// Runs an EulerianSolver in the viewer. There is nothing to draw as
+// billboards: the solver deposits straight into its grid, which the renderer
+// uploads as the contamination texture. Steps at a fixed timestep since the
+// solver's transport is prepared for one step length.
+class EulerianGridSystem : public ParticleBackend {
+public:
+    static constexpr float timeStep = 1.0f / 60.0f;
+    // Frames slower than this many steps fall behind instead of stalling
+    static constexpr int maxStepsPerFrame = 4;
+
+    EulerianGridSystem();
+
+    void initialize() override {}
+    void release(const glm::vec3& sourcePos, int powerMW, const ReleaseProfile& profile) override;
+    void update(float deltaTime, const WindGrid& windGrid) override;
+    void prepareInstances() override {}
+    void draw() override {}
+    void setSeed(uint64_t seed) override { scheduler.setSeed(seed); }
+
+    // Airborne material in particles' worth
+    size_t size() override;
+    const char* getName() const override { return "Eulerian grid"; }
+    DepositionGrid* getDeposition() override { return &solver.getDeposition(); }
+
+    EulerianSolver& getSimulation() { return solver; }
+
+private:
+    EulerianSolver solver;
+    EmissionScheduler scheduler;
+    float accumulator = 0.0f;
+};
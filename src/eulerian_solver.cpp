@@ -0,0 +1,304 @@
+#include "eulerian_solver.hpp"
+#include "world_constraints.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Spread of the particles at release, uniform in +-0.5 around the source
+    const float sourceSigma = 0.29f;
+    // Explicit diffusion is stable up to 0.25 per axis; stay well below
+    const float maxDiffusionNumber = 0.2f;
+    // A species with less than a particle's worth left in the air is dropped
+    const double negligibleMass = 1.0;
+}
+
+EulerianSolver::EulerianSolver(int width, int height)
+    : width(width), height(height), stride(width + 2), deposition(width, height) {
+    cellSize = deposition.getCellSize();
+
+    scratch.assign(static_cast<size_t>(width + 2) * (height + 2), 0.0f);
+
+    const size_t tilesX = (width + tileSize - 1) / tileSize;
+    const size_t tilesZ = (height + tileSize - 1) / tileSize;
+    tileMass.assign(tilesX * tilesZ, 0.0);
+}
+
+void EulerianSolver::setWindField(const WindField* field) {
+    windField = field;
+    transferTimeStep = 0.0f;
+}
+
+void EulerianSolver::clear() {
+    species.clear();
+    deposition.clear();
+    airborneMass = 0.0;
+}
+
+float EulerianSolver::getConcentration(int x, int z) const {
+    float sum = 0.0f;
+    for (const Species& material : species)
+        sum += material.concentration[paddedIndex(x, z)];
+    return sum;
+}
+
+glm::vec2 EulerianSolver::cellCentre(int x, int z) const {
+    return glm::vec2(WorldConstraints::MAP_LEFT + (x + 0.5f) * cellSize.x,
+                     WorldConstraints::MAP_BOTTOM - (z + 0.5f) * cellSize.y);
+}
+
+// Velocity the particles settle to: the wind scaled like in the kernels, or
+// still air where there is no wind
+glm::vec3 EulerianSolver::sampleWind(glm::vec2 position, const WindGrid& windGrid) const {
+    glm::vec3 direction;
+    float velocity;
+
+    bool hasWind = windField && windField->isBaked()
+        ? windField->sample(position, direction, velocity)
+        : windGrid.blendAtPoint(position, direction, velocity);
+
+    return hasWind ? direction * velocity * windVelocityScale : glm::vec3(0.0f);
+}
+
+// Adds the batch as a small Gaussian around the source, normalised over the
+// cells it covers so no mass is lost to the discretisation.
+void EulerianSolver::emit(const EmissionBatch& batch) {
+    if (batch.count == 0)
+        return;
+
+    const EmissionParams& params = batch.params;
+    float meanLife = 0.5f * (params.minLife + params.maxLife);
+    float sizeSpread = params.maxSize - params.minSize;
+    float meanArea = sizeSpread > 0.0f
+        ? (std::pow(params.maxSize, 3.0f) - std::pow(params.minSize, 3.0f)) / (3.0f * sizeSpread)
+        : params.minSize * params.minSize;
+
+    // Particles deposit min(life, 1) per second over their quad, (meanLife - 0.5)
+    // times their area over a lifetime; an exponential decay with the same
+    // mean life deposits that at a constant rate per unit mass.
+    const float removalRate = 1.0f / meanLife;
+    const float depositionRate = (meanLife - 0.5f) * meanArea * removalRate;
+
+    float x = (batch.sourcePos.x - WorldConstraints::MAP_LEFT) / cellSize.x - 0.5f;
+    float z = (WorldConstraints::MAP_BOTTOM - batch.sourcePos.z) / cellSize.y - 0.5f;
+    int reachX = static_cast<int>(std::ceil(3.0f * sourceSigma / cellSize.x));
+    int reachZ = static_cast<int>(std::ceil(3.0f * sourceSigma / cellSize.y));
+    int x0 = std::max(static_cast<int>(std::round(x)) - reachX, 0);
+    int x1 = std::min(static_cast<int>(std::round(x)) + reachX + 1, width);
+    int z0 = std::max(static_cast<int>(std::round(z)) - reachZ, 0);
+    int z1 = std::min(static_cast<int>(std::round(z)) + reachZ + 1, height);
+    if (x0 >= x1 || z0 >= z1)
+        return;
+
+    std::vector<float> weights(static_cast<size_t>(x1 - x0) * (z1 - z0));
+    double total = 0.0;
+    for (int row = z0; row < z1; ++row) {
+        for (int col = x0; col < x1; ++col) {
+            float dx = (col - x) * cellSize.x;
+            float dz = (row - z) * cellSize.y;
+            float weight = std::exp(-(dx * dx + dz * dz) / (2.0f * sourceSigma * sourceSigma));
+            weights[static_cast<size_t>(row - z0) * (x1 - x0) + (col - x0)] = weight;
+            total += weight;
+        }
+    }
+
+    auto match = std::find_if(species.begin(), species.end(), [&](const Species& material) {
+        return material.removalRate == removalRate && material.depositionRate == depositionRate;
+    });
+    if (match == species.end()) {
+        species.push_back({ removalRate, depositionRate, std::vector<float>(scratch.size(), 0.0f) });
+        match = species.end() - 1;
+    }
+
+    const float scale = static_cast<float>(batch.count / (total * cellSize.x * cellSize.y));
+    for (int row = z0; row < z1; ++row) {
+        for (int col = x0; col < x1; ++col)
+            match->concentration[paddedIndex(col, row)] += scale * weights[static_cast<size_t>(row - z0) * (x1 - x0) + (col - x0)];
+    }
+    match->airborneMass += batch.count;
+    airborneMass += batch.count;
+}
+
+void EulerianSolver::update(float deltaTime, const WindGrid& windGrid) {
+    if (deltaTime <= 0.0f)
+        return;
+
+    // The wind does not change, so the transfers only do with the step
+    if (transferTimeStep != deltaTime)
+        computeTransfers(deltaTime, windGrid);
+
+    float diffusionNumber = diffusivity * deltaTime * (1.0f / (cellSize.x * cellSize.x) + 1.0f / (cellSize.y * cellSize.y));
+    int substeps = std::max(1, static_cast<int>(std::ceil(diffusionNumber / maxDiffusionNumber)));
+
+    airborneMass = 0.0;
+    for (Species& material : species) {
+        advect(material);
+        diffuse(material, deltaTime, substeps);
+        airborneMass += material.airborneMass;
+    }
+    species.erase(std::remove_if(species.begin(), species.end(),
+                                 [](const Species& material) { return material.airborneMass < negligibleMass; }),
+                  species.end());
+    deposition.markChanged();
+}
+
+// Moves every cell centre forward along the wind with a midpoint step and
+// splits its material bilinearly between the four cells around where it
+// lands. The wind is not divergence free, so gathering from departure points
+// would create material where the flow converges; scattering moves exactly
+// what each cell holds, and only what lands off the map is lost. The scatter
+// is transposed into per-cell gathers once so advection runs tile-parallel.
+void EulerianSolver::computeTransfers(float deltaTime, const WindGrid& windGrid) {
+    transferTimeStep = deltaTime;
+
+    const size_t cells = static_cast<size_t>(width) * height;
+    std::vector<glm::vec2> arrivals(cells);
+
+    forEachTile([&](size_t, int x0, int x1, int z0, int z1) {
+        for (int z = z0; z < z1; ++z) {
+            for (int x = x0; x < x1; ++x) {
+                glm::vec2 position = cellCentre(x, z);
+                glm::vec3 wind = sampleWind(position, windGrid);
+                glm::vec2 midpoint = position + glm::vec2(wind.x, wind.z) * (0.5f * deltaTime);
+                wind = sampleWind(midpoint, windGrid);
+                glm::vec2 arrival = position + glm::vec2(wind.x, wind.z) * deltaTime;
+
+                arrivals[static_cast<size_t>(z) * width + x] =
+                    glm::vec2((arrival.x - WorldConstraints::MAP_LEFT) / cellSize.x - 0.5f,
+                              (WorldConstraints::MAP_BOTTOM - arrival.y) / cellSize.y - 0.5f);
+            }
+        }
+    });
+
+    // Calls visit(target, source, weight) for the corners of every arrival that
+    // are on the map
+    auto scatter = [&](auto&& visit) {
+        for (int z = 0; z < height; ++z) {
+            for (int x = 0; x < width; ++x) {
+                glm::vec2 arrival = arrivals[static_cast<size_t>(z) * width + x];
+                glm::vec2 base = glm::floor(arrival);
+                glm::vec2 f = arrival - base;
+                int bx = static_cast<int>(base.x), bz = static_cast<int>(base.y);
+                const float weights[4] = { (1 - f.x) * (1 - f.y), f.x * (1 - f.y), (1 - f.x) * f.y, f.x * f.y };
+
+                for (int corner = 0; corner < 4; ++corner) {
+                    int tx = bx + (corner & 1), tz = bz + (corner >> 1);
+                    if (tx < 0 || tx >= width || tz < 0 || tz >= height || weights[corner] <= 0.0f)
+                        continue;
+                    visit(static_cast<size_t>(tz) * width + tx, paddedIndex(x, z), weights[corner]);
+                }
+            }
+        }
+    };
+
+    transferStart.assign(cells + 1, 0);
+    scatter([&](size_t target, size_t, float) { ++transferStart[target + 1]; });
+    for (size_t i = 0; i < cells; ++i)
+        transferStart[i + 1] += transferStart[i];
+
+    transfers.resize(transferStart[cells]);
+    std::vector<uint32_t> next(transferStart.begin(), transferStart.end() - 1);
+    scatter([&](size_t target, size_t source, float weight) {
+        transfers[next[target]++] = { static_cast<int32_t>(source), weight };
+    });
+}
+
+void EulerianSolver::advect(Species& material) {
+    const std::vector<float>& concentration = material.concentration;
+    forEachTile([&](size_t, int x0, int x1, int z0, int z1) {
+        for (int z = z0; z < z1; ++z) {
+            const uint32_t* start = &transferStart[static_cast<size_t>(z) * width];
+            float* out = &scratch[paddedIndex(0, z)];
+
+            for (int x = x0; x < x1; ++x) {
+                float sum = 0.0f;
+                for (uint32_t i = start[x]; i < start[x + 1]; ++i)
+                    sum += transfers[i].weight * concentration[transfers[i].source];
+                out[x] = sum;
+            }
+        }
+    });
+
+    material.concentration.swap(scratch);
+}
+
+// Five-point explicit diffusion, then removal with deposition in the last
+// substep. Rows are plain loops over contiguous floats so they vectorise.
+// Solver tiles coincide with deposition tiles, so each task writes only its
+// own and clean rows leave the deposition unallocated.
+void EulerianSolver::diffuse(Species& material, float deltaTime, int substeps) {
+    std::vector<float>& concentration = material.concentration;
+    const float dt = deltaTime / substeps;
+    const float ax = diffusivity * dt / (cellSize.x * cellSize.x);
+    const float az = diffusivity * dt / (cellSize.y * cellSize.y);
+    const float centre = 1.0f - 2.0f * ax - 2.0f * az;
+    const float decay = std::exp(-material.removalRate * deltaTime);
+    const float deposit = material.depositionRate * deltaTime;
+    const float cellArea = cellSize.x * cellSize.y;
+    auto lock = deposition.lock();
+
+    for (int substep = 0; substep < substeps; ++substep) {
+        const bool last = substep == substeps - 1;
+
+        forEachTile([&](size_t tile, int x0, int x1, int z0, int z1) {
+            double mass = 0.0;
+            float* dose = nullptr; // the matching deposition tile, once needed
+
+            for (int z = z0; z < z1; ++z) {
+                const float* c = &concentration[paddedIndex(0, z)];
+                const float* up = c - stride;
+                const float* down = c + stride;
+                float* out = &scratch[paddedIndex(0, z)];
+
+                for (int x = x0; x < x1; ++x)
+                    out[x] = centre * c[x] + ax * (c[x - 1] + c[x + 1]) + az * (up[x] + down[x]);
+
+                if (!last)
+                    continue;
+
+                float rowMass = 0.0f;
+                for (int x = x0; x < x1; ++x)
+                    rowMass += out[x];
+                if (rowMass <= 0.0f)
+                    continue;
+
+                if (!dose)
+                    dose = deposition.touchTile(tile);
+                float* cells = &dose[(z - z0) * DepositionGrid::tileSize];
+                for (int x = x0; x < x1; ++x) {
+                    cells[x - x0] += deposit * out[x];
+                    out[x] *= decay;
+                }
+                mass += rowMass * decay * cellArea;
+            }
+
+            if (last)
+                tileMass[tile] = mass;
+        });
+
+        concentration.swap(scratch);
+    }
+
+    material.airborneMass = 0.0;
+    for (double mass : tileMass)
+        material.airborneMass += mass;
+}
+
+void EulerianSolver::forEachTile(const std::function<void(size_t tile, int x0, int x1, int z0, int z1)>& task) {
+    const size_t tilesX = (width + tileSize - 1) / tileSize;
+    const size_t tilesZ = (height + tileSize - 1) / tileSize;
+
+    auto runTile = [&](size_t tile) {
+        int x0 = static_cast<int>(tile % tilesX) * tileSize;
+        int z0 = static_cast<int>(tile / tilesX) * tileSize;
+        task(tile, x0, std::min(x0 + tileSize, width), z0, std::min(z0 + tileSize, height));
+    };
+
+    if (threadPool) {
+        threadPool->parallelFor(tilesX * tilesZ, runTile);
+    }
+    else {
+        for (size_t tile = 0; tile < tilesX * tilesZ; ++tile)
+            runTile(tile);
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "deposition_grid.hpp"
+#include "emission_scheduler.hpp"
+#include "thread_pool.hpp"
+#include "wind_field.hpp"
+#include "wind_grid.hpp"
+
+// Transports released material as a concentration field over the map
+// instead of as particles. Every step advects the field along the wind with
+// a forward semi-Lagrangian remap, diffuses it explicitly and removes material at the rate
+// the particles would die, depositing it on the way. Cost depends only on the
+// grid resolution, not on how much is released.
+//
+// Releases of different power die and deposit at different rates, so material
+// is kept in one field per pair of rates and every field is transported on
+// its own; overlapping releases of different plants cost one field each.
+//
+// Cells line up with a DepositionGrid of the same size: row 0 at MAP_BOTTOM,
+// concentration in particles per unit area.
+class EulerianSolver {
+public:
+    static constexpr int defaultWidth = 764;
+    static constexpr int defaultHeight = 400;
+    static constexpr float defaultDiffusivity = 0.05f;
+
+    EulerianSolver(int width = defaultWidth, int height = defaultHeight);
+
+    void emit(const EmissionBatch& batch);
+    void update(float deltaTime, const WindGrid& windGrid);
+    void clear();
+
+    // Samples wind from a baked field instead of blending the grid per cell
+    void setWindField(const WindField* field);
+    // Splits every pass into tiles spread across the pool's threads
+    void setThreadPool(ThreadPool* pool) { threadPool = pool; }
+    // Horizontal eddy diffusivity in units^2 per second
+    void setDiffusivity(float value) { diffusivity = value; }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    float getConcentration(int x, int z) const;
+    double getAirborneMass() const { return airborneMass; }
+    DepositionGrid& getDeposition() { return deposition; }
+
+private:
+    // Share of a source cell's material that lands in a cell after one step
+    struct Transfer {
+        int32_t source; // padded index
+        float weight;
+    };
+
+    static constexpr int tileSize = DepositionGrid::tileSize;
+
+    const int width;
+    const int height;
+    const int stride; // padded row length
+    glm::vec2 cellSize;
+
+    // Material of the releases whose particles die and deposit at the same
+    // rates
+    struct Species {
+        float removalRate;
+        float depositionRate;
+        // Padded by one cell of zeros on every side, which is what flows in
+        std::vector<float> concentration;
+        double airborneMass = 0.0;
+    };
+
+    std::vector<Species> species;
+    std::vector<float> scratch;
+    // Transfers into each cell, cell i's in [transferStart[i], transferStart[i + 1])
+    std::vector<Transfer> transfers;
+    std::vector<uint32_t> transferStart;
+    std::vector<double> tileMass;
+    float transferTimeStep = 0.0f;
+
+    DepositionGrid deposition;
+    const WindField* windField = nullptr;
+    ThreadPool* threadPool = nullptr;
+    float diffusivity = defaultDiffusivity;
+    double airborneMass = 0.0;
+
+    size_t paddedIndex(int x, int z) const { return static_cast<size_t>(z + 1) * stride + (x + 1); }
+    glm::vec2 cellCentre(int x, int z) const;
+    glm::vec3 sampleWind(glm::vec2 position, const WindGrid& windGrid) const;
+
+    void computeTransfers(float deltaTime, const WindGrid& windGrid);
+    void advect(Species& material);
+    void diffuse(Species& material, float deltaTime, int substeps);
+    void forEachTile(const std::function<void(size_t tile, int x0, int x1, int z0, int z1)>& task);
+};
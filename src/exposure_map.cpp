@@ -0,0 +1,216 @@
+#include "exposure_map.hpp"
+#include "world_constraints.hpp"
+
+#include <stb_image/stb_image.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+    // Pixel of a raster spanning the same extent as count cells, under the
+    // centre of cell, for count cells padded to padded entries
+    std::vector<int> mapAxis(int count, int padded, int rasterSize) {
+        std::vector<int> pixels(padded, 0);
+        for (int i = 0; i < padded; ++i) {
+            int pixel = static_cast<int>((std::min(i, count - 1) + 0.5) * rasterSize / count);
+            pixels[i] = std::min(pixel, rasterSize - 1);
+        }
+        return pixels;
+    }
+}
+
+ExposureMap::ExposureMap() {
+    regions.resize(1);
+    regions[0].name = "Outside regions";
+}
+
+bool ExposureMap::loadRegions(const std::string& rasterPath, const std::string& namesPath) {
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(true);
+    unsigned char* data = stbi_load(rasterPath.c_str(), &width, &height, &channels, 1);
+    if (!data) {
+        std::cerr << "[ExposureMap] ERROR: cannot load region raster " << rasterPath << "\n";
+        setRegions({}, 0, 0, {});
+        return false;
+    }
+    std::vector<uint8_t> raster(data, data + static_cast<size_t>(width) * height);
+    stbi_image_free(data);
+
+    std::vector<std::string> names;
+    if (!namesPath.empty()) {
+        std::ifstream file(namesPath);
+        for (std::string line; std::getline(file, line);) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            names.push_back(line);
+        }
+        if (names.empty())
+            std::cerr << "[ExposureMap] ERROR: no region names in " << namesPath << "\n";
+    }
+
+    setRegions(std::move(raster), width, height, names);
+    return true;
+}
+
+bool ExposureMap::loadPopulation(const std::string& rasterPath, float densityScale) {
+    int width, height, channels;
+    stbi_set_flip_vertically_on_load_thread(true);
+    stbi_us* data = stbi_load_16(rasterPath.c_str(), &width, &height, &channels, 1);
+    if (!data) {
+        std::cerr << "[ExposureMap] ERROR: cannot load population raster " << rasterPath << "\n";
+        setPopulation({}, 0, 0);
+        return false;
+    }
+
+    // stbi_load_16 stretches 8-bit files to 16 bits, 255 becoming 65535
+    const float scale = stbi_is_16_bit(rasterPath.c_str()) ? densityScale : densityScale / 257.0f;
+    std::vector<float> raster(static_cast<size_t>(width) * height);
+    for (size_t i = 0; i < raster.size(); ++i)
+        raster[i] = data[i] * scale;
+    stbi_image_free(data);
+
+    setPopulation(std::move(raster), width, height);
+    return true;
+}
+
+void ExposureMap::setRegions(std::vector<uint8_t> raster, int width, int height, const std::vector<std::string>& names) {
+    labels = std::move(raster);
+    labelWidth = labels.empty() ? 0 : width;
+    labelHeight = labels.empty() ? 0 : height;
+
+    int labelCount = labels.empty() ? 1 : *std::max_element(labels.begin(), labels.end()) + 1;
+    labelCount = std::max(labelCount, static_cast<int>(names.size()) + 1);
+
+    regions.assign(labelCount, RegionExposure());
+    regions[0].name = "Outside regions";
+    for (int label = 1; label < labelCount; ++label) {
+        const size_t index = label - 1;
+        regions[label].name = index < names.size() && !names[index].empty() ? names[index] : "Region " + std::to_string(label);
+    }
+
+    countPopulation();
+    invalidate();
+}
+
+void ExposureMap::setPopulation(std::vector<float> raster, int width, int height) {
+    density = std::move(raster);
+    densityWidth = density.empty() ? 0 : width;
+    densityHeight = density.empty() ? 0 : height;
+    countPopulation();
+    invalidate();
+}
+
+void ExposureMap::countPopulation() {
+    for (RegionExposure& region : regions)
+        region.population = 0.0;
+    if (density.empty())
+        return;
+
+    const double pixelArea = (WorldConstraints::MAP_RIGHT - WorldConstraints::MAP_LEFT) *
+                             (WorldConstraints::MAP_BOTTOM - WorldConstraints::MAP_TOP) /
+                             (static_cast<double>(densityWidth) * densityHeight);
+    std::vector<int> columns, rows;
+    if (!labels.empty()) {
+        columns = mapAxis(densityWidth, densityWidth, labelWidth);
+        rows = mapAxis(densityHeight, densityHeight, labelHeight);
+    }
+
+    for (int y = 0; y < densityHeight; ++y) {
+        for (int x = 0; x < densityWidth; ++x) {
+            int label = labels.empty() ? 0 : labels[static_cast<size_t>(rows[y]) * labelWidth + columns[x]];
+            regions[label].population += density[static_cast<size_t>(y) * densityWidth + x] * pixelArea;
+        }
+    }
+}
+
+void ExposureMap::mapCells(const DepositionGrid& grid) {
+    const int paddedWidth = grid.getTilesX() * DepositionGrid::tileSize;
+    const int paddedHeight = grid.getTilesZ() * DepositionGrid::tileSize;
+
+    labelColumns.assign(paddedWidth, 0);
+    labelRows.assign(paddedHeight, 0);
+    densityColumns.assign(paddedWidth, 0);
+    densityRows.assign(paddedHeight, 0);
+    if (!labels.empty()) {
+        labelColumns = mapAxis(grid.getWidth(), paddedWidth, labelWidth);
+        labelRows = mapAxis(grid.getHeight(), paddedHeight, labelHeight);
+    }
+    if (!density.empty()) {
+        densityColumns = mapAxis(grid.getWidth(), paddedWidth, densityWidth);
+        densityRows = mapAxis(grid.getHeight(), paddedHeight, densityHeight);
+    }
+
+    lastGrid = &grid;
+    lastWidth = grid.getWidth();
+    lastHeight = grid.getHeight();
+}
+
+void ExposureMap::update(const DepositionGrid& grid, ThreadPool* pool) {
+    if (&grid == lastGrid && grid.getVersion() == lastVersion && grid.getGeneration() == lastGeneration)
+        return;
+    if (&grid != lastGrid || grid.getWidth() != lastWidth || grid.getHeight() != lastHeight)
+        mapCells(grid);
+
+    const size_t regionCount = regions.size();
+    const int tileSize = DepositionGrid::tileSize;
+    auto lock = grid.lock();
+    lastVersion = grid.getVersion();
+    lastGeneration = grid.getGeneration();
+
+    tileList.clear();
+    for (size_t tile = 0; tile < static_cast<size_t>(grid.getTilesX()) * grid.getTilesZ(); ++tile) {
+        if (grid.getTile(tile))
+            tileList.push_back(tile);
+    }
+
+    const size_t slices = pool ? std::max<size_t>(std::min<size_t>(pool->getThreadCount(), tileList.size()), 1) : 1;
+    sliceSums.assign(slices * regionCount * 2, 0.0);
+
+    auto sumSlice = [&](size_t slice) {
+        double* sums = &sliceSums[slice * regionCount * 2];
+        for (size_t i = slice; i < tileList.size(); i += slices) {
+            const size_t tile = tileList[i];
+            const int col0 = static_cast<int>(tile % grid.getTilesX()) * tileSize;
+            const int row0 = static_cast<int>(tile / grid.getTilesX()) * tileSize;
+            const float* cells = grid.getTile(tile);
+
+            for (int row = row0; row < row0 + tileSize; ++row, cells += tileSize) {
+                const uint8_t* labelRow = labels.empty() ? nullptr : &labels[static_cast<size_t>(labelRows[row]) * labelWidth];
+                const float* densityRow = density.empty() ? nullptr : &density[static_cast<size_t>(densityRows[row]) * densityWidth];
+
+                for (int col = 0; col < tileSize; ++col) {
+                    const float value = cells[col];
+                    if (value == 0.0f)
+                        continue;
+
+                    const size_t label = labelRow ? labelRow[labelColumns[col0 + col]] : 0;
+                    sums[label * 2] += value;
+                    if (densityRow)
+                        sums[label * 2 + 1] += value * densityRow[densityColumns[col0 + col]];
+                }
+            }
+        }
+    };
+
+    if (slices > 1)
+        pool->parallelFor(slices, sumSlice);
+    else
+        sumSlice(0);
+    lock.unlock();
+
+    const glm::vec2 cellSize = grid.getCellSize();
+    const double cellArea = static_cast<double>(cellSize.x) * cellSize.y;
+    totalDeposited = totalPersonDose = 0.0;
+    for (size_t label = 0; label < regionCount; ++label) {
+        double deposited = 0.0, personDose = 0.0;
+        for (size_t slice = 0; slice < slices; ++slice) {
+            deposited += sliceSums[(slice * regionCount + label) * 2];
+            personDose += sliceSums[(slice * regionCount + label) * 2 + 1];
+        }
+        regions[label].deposited = deposited * cellArea;
+        regions[label].personDose = personDose * cellArea;
+        totalDeposited += regions[label].deposited;
+        totalPersonDose += regions[label].personDose;
+    }
+}
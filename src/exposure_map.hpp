@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "deposition_grid.hpp"
+#include "thread_pool.hpp"
+
+// Deposition and population-weighted dose of one region
+struct RegionExposure {
+    std::string name;
+    double population = 0.0;  // people living in the region
+    double deposited = 0.0;   // contamination times area
+    double personDose = 0.0;  // contamination times people exposed to it
+};
+
+// Totals a deposition grid per region and weighted by population. Both come
+// from rasters covering the map extent like europe_map.png, at any
+// resolution: a label raster whose grey value is a region index, 0 for none,
+// and a population density raster. Every grid cell takes the raster pixel
+// under its centre.
+//
+// update() builds a label histogram over the grid's allocated tiles, in
+// parallel with one histogram per slice, so its cost follows the contaminated
+// area rather than the map. Queries only read the last histogram.
+class ExposureMap {
+public:
+    ExposureMap();
+
+    // Grey 8-bit PNG; names holds one region name per line, the first line
+    // naming label 1. Returns false and leaves every cell in region 0 if the
+    // raster cannot be read; missing names are numbered, all of them if
+    // namesPath is empty.
+    bool loadRegions(const std::string& rasterPath, const std::string& namesPath);
+    // Grey 8- or 16-bit PNG of people per map unit^2 divided by densityScale.
+    // Returns false and drops the population if it cannot be read.
+    bool loadPopulation(const std::string& rasterPath, float densityScale);
+
+    // Same, from rasters already in memory, row 0 at MAP_BOTTOM
+    void setRegions(std::vector<uint8_t> labels, int width, int height, const std::vector<std::string>& names);
+    void setPopulation(std::vector<float> density, int width, int height);
+
+    bool hasRegions() const { return !labels.empty(); }
+    bool hasPopulation() const { return !density.empty(); }
+
+    // Recomputes the totals unless the grid has not changed since the last call
+    void update(const DepositionGrid& grid, ThreadPool* pool);
+
+    // Index 0 collects everything outside the labelled regions
+    const std::vector<RegionExposure>& getRegions() const { return regions; }
+    double getTotalDeposited() const { return totalDeposited; }
+    double getTotalPersonDose() const { return totalPersonDose; }
+
+private:
+    std::vector<uint8_t> labels;
+    int labelWidth = 0, labelHeight = 0;
+    std::vector<float> density;
+    int densityWidth = 0, densityHeight = 0;
+
+    std::vector<RegionExposure> regions;
+    double totalDeposited = 0.0;
+    double totalPersonDose = 0.0;
+
+    // Raster pixel under each grid column and row, padded to whole tiles
+    std::vector<int> labelColumns, labelRows, densityColumns, densityRows;
+    const DepositionGrid* lastGrid = nullptr;
+    int lastWidth = 0, lastHeight = 0;
+    uint64_t lastVersion = 0;
+    uint64_t lastGeneration = 0;
+
+    std::vector<size_t> tileList;
+    std::vector<double> sliceSums; // slices x regions x {deposited, personDose}
+
+    void countPopulation();
+    void mapCells(const DepositionGrid& grid);
+    void invalidate() { lastGrid = nullptr; }
+};
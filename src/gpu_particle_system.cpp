@@ -0,0 +1,231 @@
+#include "gpu_particle_system.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+GpuParticleSystem::~GpuParticleSystem() {
+    if (!stateBuffers[0])
+        return;
+
+    glDeleteBuffers(2, stateBuffers);
+    glDeleteVertexArrays(2, updateVAOs);
+    glDeleteVertexArrays(2, renderVAOs);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteQueries(1, &countQuery);
+    if (windTexture)
+        glDeleteTextures(1, &windTexture);
+}
+
+void GpuParticleSystem::initialize() {
+    updateShader.emplace("shaders/particle_update.vs", "shaders/particle_update.gs",
+                         std::vector<const char *>{ "outPosition", "outDirection", "outVelocity", "outLife", "outScale" });
+    updateUniforms.deltaTime = updateShader->getUniformLocation("deltaTime");
+    updateUniforms.windVelocityScale = updateShader->getUniformLocation("windVelocityScale");
+    updateUniforms.hasWindField = updateShader->getUniformLocation("hasWindField");
+    updateUniforms.windFieldOrigin = updateShader->getUniformLocation("windFieldOrigin");
+    updateUniforms.windFieldSize = updateShader->getUniformLocation("windFieldSize");
+    updateUniforms.windFieldCellSize = updateShader->getUniformLocation("windFieldCellSize");
+    // The wind field always sits on unit 0
+    updateShader->use();
+    updateShader->setInt("windField", 0);
+    glUseProgram(0);
+
+    float quadVerts[] = {
+        -0.5f, -0.5f,
+         0.5f, -0.5f,
+        -0.5f,  0.5f,
+         0.5f,  0.5f
+    };
+
+    glGenBuffers(1, &quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVerts), quadVerts, GL_STATIC_DRAW);
+
+    glGenBuffers(2, stateBuffers);
+    glGenVertexArrays(2, updateVAOs);
+    glGenVertexArrays(2, renderVAOs);
+    glGenQueries(1, &countQuery);
+
+    const GLsizei stride = sizeof(GpuParticle);
+    for (int i = 0; i < 2; ++i) {
+        glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[i]);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(GpuParticle) * maxParticles, NULL, GL_DYNAMIC_COPY);
+
+        // Update pass reads one particle per vertex
+        glBindVertexArray(updateVAOs[i]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, position));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, direction));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, velocity));
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, life));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(4, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, scale));
+
+        // Render pass reads one particle per instance, with the same layout as
+        // the CPU instance buffer: position, intensity (= life) and scale
+        glBindVertexArray(renderVAOs[i]);
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[i]);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, position));
+        glVertexAttribDivisor(1, 1);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, life));
+        glVertexAttribDivisor(2, 1);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, stride, (void *)offsetof(GpuParticle, scale));
+        glVertexAttribDivisor(3, 1);
+    }
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GpuParticleSystem::setWindField(const WindField *field) {
+    windField = field;
+    windTextureDirty = true;
+}
+
+void GpuParticleSystem::uploadWindTexture() {
+    windTextureDirty = false;
+
+    if (!windField || !windField->isBaked()) {
+        if (windTexture)
+            glDeleteTextures(1, &windTexture);
+        windTexture = 0;
+        return;
+    }
+
+    if (!windTexture)
+        glGenTextures(1, &windTexture);
+
+    glBindTexture(GL_TEXTURE_2D, windTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, windField->getWidth(), windField->getHeight(), 0,
+                 GL_RGBA, GL_FLOAT, windField->getLattice().data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+// Makes the last update pass's output current once its query has a result,
+// without waiting for it. The query is usually ready by the next frame.
+void GpuParticleSystem::resolveCount() {
+    if (!countPending)
+        return;
+
+    GLuint available = GL_FALSE;
+    glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    GLuint written = 0;
+    glGetQueryObjectuiv(countQuery, GL_QUERY_RESULT, &written);
+    particleCount = written;
+    current = 1 - current;
+    countPending = false;
+}
+
+size_t GpuParticleSystem::size() {
+    resolveCount();
+    return particleCount;
+}
+
+void GpuParticleSystem::release(const glm::vec3 &sourcePos, int powerMW, const ReleaseProfile &profile) {
+    scheduler.schedule(sourcePos, powerMW, profile, maxParticles);
+}
+
+// Appends the batch behind the current particles. The scheduler only hands
+// out what fits, and update() has resolved the count before asking.
+void GpuParticleSystem::emit(const EmissionBatch &batch) {
+    const size_t count = std::min(batch.count, maxParticles - particleCount);
+    if (count == 0)
+        return;
+
+    std::vector<GpuParticle> emitted;
+    emitted.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        EmittedParticle p = ParticleEmission::sample(batch.sourcePos, batch.params, batch.seed, batch.emission,
+                                                     batch.firstIndex + i);
+        emitted.push_back({ p.position, p.direction, p.velocity, p.life, p.scale });
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, stateBuffers[current]);
+    glBufferSubData(GL_ARRAY_BUFFER, particleCount * sizeof(GpuParticle), count * sizeof(GpuParticle), emitted.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    particleCount += count;
+}
+
+// Wind comes from the field texture, not the grid. Skips the pass while the
+// previous one has no result yet and makes up the time in the next.
+void GpuParticleSystem::update(float deltaTime, const WindGrid &) {
+    if (windTextureDirty)
+        uploadWindTexture();
+
+    pendingTime += deltaTime;
+    resolveCount();
+    if (countPending)
+        return;
+
+    deltaTime = pendingTime;
+    pendingTime = 0.0f;
+    for (const EmissionBatch &batch : scheduler.collectDue(deltaTime, maxParticles - particleCount))
+        emit(batch);
+
+    if (particleCount == 0)
+        return;
+
+    const int next = 1 - current;
+    Shader &shader = *updateShader;
+    shader.use();
+    shader.setFloat(updateUniforms.deltaTime, deltaTime);
+    shader.setFloat(updateUniforms.windVelocityScale, windVelocityScale);
+    shader.setBool(updateUniforms.hasWindField, windTexture != 0);
+
+    if (windTexture) {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, windTexture);
+        shader.setVec2(updateUniforms.windFieldOrigin, windField->getOrigin());
+        shader.setVec2(updateUniforms.windFieldSize, glm::vec2(windField->getWidth(), windField->getHeight()));
+        shader.setFloat(updateUniforms.windFieldCellSize, windField->getCellSize());
+    }
+
+    glEnable(GL_RASTERIZER_DISCARD);
+    glBindVertexArray(updateVAOs[current]);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, stateBuffers[next]);
+
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, countQuery);
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(particleCount));
+    glEndTransformFeedback();
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    glBindVertexArray(0);
+    glDisable(GL_RASTERIZER_DISCARD);
+    glUseProgram(0);
+
+    countPending = true;
+}
+
+void GpuParticleSystem::prepareInstances() {
+    // Particles are drawn straight from the state buffer, only the count is
+    // needed, and a pass finished since update() can already be shown
+    resolveCount();
+}
+
+void GpuParticleSystem::draw() {
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(renderVAOs[current]);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(particleCount));
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <optional>
+#include <vector>
+
+#include "emission_scheduler.hpp"
+#include "particle_backend.hpp"
+#include "particle_emission.hpp"
+#include "shader.hpp"
+#include "wind_field.hpp"
+
+// Particle state as stored in the GPU buffers, one record per particle.
+struct GpuParticle {
+    glm::vec3 position;
+    glm::vec3 direction;
+    float velocity;
+    float life;
+    float scale;
+};
+
+// Keeps particles in two GPU buffers and advances them with a transform
+// feedback pass, ping-ponging between the buffers each update. The wind comes
+// from the baked WindField uploaded as a texture, and the particles are drawn
+// straight from the buffer the last pass wrote, so nothing is copied from the
+// CPU except newly emitted particles.
+class GpuParticleSystem : public ParticleBackend {
+public:
+    explicit GpuParticleSystem(size_t maxParticles = 50000) : maxParticles(maxParticles) {}
+    ~GpuParticleSystem();
+
+    void initialize() override;
+    void release(const glm::vec3& sourcePos, int powerMW, const ReleaseProfile& profile) override;
+    void update(float deltaTime, const WindGrid& windGrid) override;
+    void prepareInstances() override;
+    void draw() override;
+    void setSeed(uint64_t seed) override { scheduler.setSeed(seed); }
+
+    size_t size() override;
+    const char* getName() const override { return "GPU particles"; }
+
+    // Field the update pass samples; uploaded to a texture on the next update.
+    void setWindField(const WindField* field);
+
+private:
+    const size_t maxParticles;
+    const WindField* windField = nullptr;
+    bool windTextureDirty = false;
+    EmissionScheduler scheduler;
+
+    std::optional<Shader> updateShader;
+    // Locations the update pass sets every frame, looked up once it links
+    struct UpdateUniforms {
+        GLint deltaTime = -1;
+        GLint windVelocityScale = -1;
+        GLint hasWindField = -1;
+        GLint windFieldOrigin = -1;
+        GLint windFieldSize = -1;
+        GLint windFieldCellSize = -1;
+    } updateUniforms;
+    GLuint stateBuffers[2] = {};
+    GLuint updateVAOs[2] = {};
+    GLuint renderVAOs[2] = {};
+    GLuint quadVBO = 0;
+    GLuint windTexture = 0;
+    GLuint countQuery = 0;
+
+    // Buffer holding the current particles and how many there are. An update
+    // pass writes the other buffer, which only becomes current once its
+    // feedback query has a result; until then the current particles are drawn
+    // and the time of skipped updates adds up for the next pass.
+    int current = 0;
+    size_t particleCount = 0;
+    bool countPending = false;
+    float pendingTime = 0.0f;
+
+    void emit(const EmissionBatch& batch);
+    void uploadWindTexture();
+    void resolveCount();
+};
@@ -1,89 +1,160 @@
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
-
-#include <imgui.h>
-#include <backends/imgui_impl_glfw.h>
-#include <backends/imgui_impl_opengl3.h>
-
-#include "gui.hpp"
-#include "program.hpp"
-
-void Gui::initialize(GLFWwindow *window) {
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO &io = ImGui::GetIO(); (void)io;
-
-    ImGui::StyleColorsDark();
-
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init("#version 330");
-}
-
-void Gui::shutdown() {
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-}
-
-void Gui::beginFrame() {
-    ImGui_ImplOpenGL3_NewFrame();
-    ImGui_ImplGlfw_NewFrame();
-    ImGui::NewFrame();
-}
-
-void Gui::endFrame() {
-    ImGui::Render();
-    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-}
-
-void Gui::render(Program *program) {
-
-    ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Once);
-    ImGui::SetNextWindowSize(ImVec2(200, 100), ImGuiCond_Once);
-    ImGui::Begin("Controls");
-
-    if (ImGui::Button("Show Wind Vectors")) {
-        program->renderWindVectors = true;
-    }
-
-    if (ImGui::Button("Hide Wind Vectors")) {
-        program->renderWindVectors = false;
-    }
-
-    if (ImGui::Button("Clear Contamination")) {
-        program->contaminationMask.clear();
-    }
-
-    ImGui::End();
-
-    ImGui::SetNextWindowPos(ImVec2(10, 115), ImGuiCond_Once);
-    ImGui::SetNextWindowSize(ImVec2(250, 150), ImGuiCond_Once);
-    ImGui::Begin("BOOOM!");
-
-    int selectedIndex = program->selectedPlantIndex.value_or(-1);
-
-    if (selectedIndex >= 0 && selectedIndex < program->nuclearPowerPlants.size()) {
-        const auto &plant = program->nuclearPowerPlants[selectedIndex];
-        const std::string &name = program->plantNames[selectedIndex];
-
-        ImGui::Text("Selected Plant: %s", name.c_str());
-        ImGui::Text("Power: %.1f MW", plant.powerMW);
-
-        ImGui::SliderFloat("Set Power", &program->nuclearPowerPlants[selectedIndex].powerMW, 500.0f, 8000.0f);
-    }
-    else {
-        ImGui::Text("No plant selected");
-        ImGui::Text("");
-        ImGui::Text("");
-    }
-
-    ImVec2 bigButtonSize(150, 50);
-    if (ImGui::Button("Explosion", bigButtonSize) && selectedIndex >= 0 && selectedIndex < program->nuclearPowerPlants.size()) {
-        auto &plant = program->nuclearPowerPlants[selectedIndex];
-        glm::vec3 pos = plant.position;
-        program->particleSystem.emit(pos + glm::vec3(0, 2.5f, 0), plant.powerMW);
-        program->contaminationMask.initialize(program->SCR_WIDTH, program->SCR_HEIGHT);
-    }
-
-    ImGui::End();
-}
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <imgui.h>
+#include <backends/imgui_impl_glfw.h>
+#include <backends/imgui_impl_opengl3.h>
+
+#include "gui.hpp"
+#include "program.hpp"
+
+void Gui::initialize(GLFWwindow *window) {
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO(); (void)io;
+
+    ImGui::StyleColorsDark();
+
+    ImGui_ImplGlfw_InitForOpenGL(window, true);
+    ImGui_ImplOpenGL3_Init("#version 330");
+}
+
+void Gui::shutdown() {
+    ImGui_ImplOpenGL3_Shutdown();
+    ImGui_ImplGlfw_Shutdown();
+    ImGui::DestroyContext();
+}
+
+void Gui::beginFrame() {
+    ImGui_ImplOpenGL3_NewFrame();
+    ImGui_ImplGlfw_NewFrame();
+    ImGui::NewFrame();
+}
+
+void Gui::endFrame() {
+    ImGui::Render();
+    ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+}
+
+void Gui::render(Program *program) {
+
+    ImGui::SetNextWindowPos(ImVec2(10, 10), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(200, 175), ImGuiCond_Once);
+    ImGui::Begin("Controls");
+
+    if (ImGui::Button("Show Wind Vectors")) {
+        program->renderWindVectors = true;
+    }
+
+    if (ImGui::Button("Hide Wind Vectors")) {
+        program->renderWindVectors = false;
+    }
+
+    if (ImGui::Button("Clear Contamination")) {
+        program->clearContamination();
+    }
+
+    const char *engines[] = { "CPU particles", "GPU particles", "Gaussian puffs", "Eulerian grid" };
+    ImGui::Combo("Engine", &program->particleEngine, engines, IM_ARRAYSIZE(engines));
+    ImGui::Text("%s: %zu", program->getParticles().getName(), program->getParticles().size());
+
+    if (program->particleEngine == Program::CpuParticles) {
+        SimulationThread &simulation = program->particleSystem.getSimulationThread();
+        float timeScale = simulation.getTimeScale();
+        if (ImGui::SliderFloat("Speed", &timeScale, 0.25f, 10.0f, "%.2fx"))
+            simulation.setTimeScale(timeScale);
+    }
+
+    if (program->powerPlantModel) {
+        const std::vector<GLsizei> &towerLods = program->plantInstances.getLodInstanceCounts();
+        ImGui::Text("Tower triangles: %zu", program->plantInstances.getTriangleCount(*program->powerPlantModel));
+        for (size_t lod = 0; lod < towerLods.size(); ++lod)
+            ImGui::Text("  LOD %zu: %d towers", lod, towerLods[lod]);
+    }
+    if (size_t loading = program->assetLoader.getPendingCount())
+        ImGui::Text("Loading %zu assets...", loading);
+
+    ImGui::End();
+
+    ImGui::SetNextWindowPos(ImVec2(10, 190), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(250, 250), ImGuiCond_Once);
+    ImGui::Begin("BOOOM!");
+
+    int selectedIndex = program->selectedPlantIndex.value_or(-1);
+
+    if (selectedIndex >= 0 && selectedIndex < program->nuclearPowerPlants.size()) {
+        const auto &plant = program->nuclearPowerPlants[selectedIndex];
+        ImGui::Text("Selected Plant: %s", plant.name.c_str());
+        ImGui::Text("Power: %.1f MW", plant.powerMW);
+
+        ImGui::SliderFloat("Set Power", &program->nuclearPowerPlants[selectedIndex].powerMW, 500.0f, 8000.0f);
+    }
+    else {
+        ImGui::Text("No plant selected");
+        ImGui::Text("");
+        ImGui::Text("");
+    }
+
+    const char *releaseShapes[] = { "Instant", "Constant", "Decaying" };
+    ImGui::Combo("Release", &program->releaseShape, releaseShapes, IM_ARRAYSIZE(releaseShapes));
+    if (program->releaseShape != Program::InstantRelease) {
+        ImGui::SliderFloat("Duration", &program->releaseDuration, 1.0f, 3600.0f, "%.0f s", ImGuiSliderFlags_Logarithmic);
+    }
+
+    std::vector<const char *> decayNames = { "None" };
+    for (const Nuclide &nuclide : program->nuclides)
+        decayNames.push_back(nuclide.name.c_str());
+    int decayChoice = program->decayNuclide + 1;
+    if (ImGui::Combo("Decay", &decayChoice, decayNames.data(), static_cast<int>(decayNames.size())))
+        program->decayNuclide = decayChoice - 1;
+    if (program->decayNuclide >= 0) {
+        ImGui::SliderFloat("Days/s", &program->decayDaysPerSecond, 0.01f, 365.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+    }
+
+    ImVec2 bigButtonSize(150, 50);
+    if (ImGui::Button("Explosion", bigButtonSize) && selectedIndex >= 0 && selectedIndex < program->nuclearPowerPlants.size()) {
+        auto &plant = program->nuclearPowerPlants[selectedIndex];
+        program->getParticles().release(plant.getEmissionPoint(), plant.powerMW, program->getReleaseProfile(plant.powerMW));
+        program->contaminationMask.initialize(program->CONTAMINATION_WIDTH, program->CONTAMINATION_HEIGHT);
+    }
+
+    ImGui::End();
+
+    ImGui::SetNextWindowPos(ImVec2(10, 450), ImGuiCond_Once);
+    ImGui::SetNextWindowSize(ImVec2(250, 160), ImGuiCond_Once);
+    ImGui::Begin("Contamination");
+
+    ContaminationSummary summary = program->contaminationStats.getLatest();
+    if (summary.sequence > 0) {
+        ImGui::Text("Low:  %.4g", summary.lowArea);
+        ImGui::Text("Mid:  %.4g", summary.midArea);
+        ImGui::Text("High: %.4g", summary.highArea);
+        ImGui::Text("Total: %.4g  Max: %.3f", summary.total, summary.max);
+    }
+    else {
+        ImGui::Text("No summary yet");
+    }
+
+    // Region totals need a CPU deposition grid and rasters to total over; the
+    // default ones under textures/ are not shipped
+    const ExposureMap &exposure = program->exposureMap;
+    if (!exposure.hasRegions() && !exposure.hasPopulation()) {
+        ImGui::Separator();
+        ImGui::TextWrapped("No region or population rasters loaded, start with --regions or --population for exposure totals");
+    }
+    else if (program->getParticles().getDeposition()) {
+        ImGui::Separator();
+        ImGui::Text("Exposure, every %d frames", program->statsInterval);
+        ImGui::Text("Person dose: %.4g", exposure.getTotalPersonDose());
+        for (const RegionExposure &region : exposure.getRegions()) {
+            if (region.deposited > 0.0)
+                ImGui::Text("%s: %.4g / %.4g", region.name.c_str(), region.deposited, region.personDose);
+        }
+    }
+
+    bool writeStats = program->contaminationStats.hasSink();
+    if (ImGui::Checkbox("Write CSV", &writeStats))
+        program->contaminationStats.setSink(writeStats ? "contamination_stats.csv" : "");
+
+    ImGui::End();
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stb_image/stb_image.h>
+
+#include <memory>
+#include <string>
+
+// Pixels decoded by stb_image. Decoding needs no GL context, so it can run
+// on a loader thread and hand the result to the thread that uploads it.
+struct ImageData {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::unique_ptr<unsigned char, void (*)(void*)> pixels{ nullptr, stbi_image_free };
+
+    explicit operator bool() const { return pixels != nullptr; }
+
+    // path is used as given; the flip only applies to this thread's decode
+    static ImageData load(const std::string& path, bool flipVertically) {
+        ImageData image;
+        stbi_set_flip_vertically_on_load_thread(flipVertically);
+        image.pixels.reset(stbi_load(path.c_str(), &image.width, &image.height, &image.channels, 0));
+        return image;
+    }
+};
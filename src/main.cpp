@@ -1,8 +1,31 @@
 #include "program.hpp"
 
-int main() {
+#include <cstdlib>
+#include <cstring>
+
+int main(int argc, char** argv) {
+    // --serial-loading loads every asset on the main thread before the first
+    // frame, as startup used to, to compare the loader's timings against.
+    // --regions, --region-names, --population and --population-scale point
+    // the exposure totals at rasters of their own, as for sim_headless.
+    bool serialLoading = false;
+    ExposureRasters exposureRasters;
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(argv[i], "--serial-loading") == 0)
+            serialLoading = true;
+        else if (std::strcmp(argv[i], "--regions") == 0 && value)
+            exposureRasters.regions = argv[++i];
+        else if (std::strcmp(argv[i], "--region-names") == 0 && value)
+            exposureRasters.regionNames = argv[++i];
+        else if (std::strcmp(argv[i], "--population") == 0 && value)
+            exposureRasters.population = argv[++i];
+        else if (std::strcmp(argv[i], "--population-scale") == 0 && value)
+            exposureRasters.populationScale = std::strtof(argv[++i], nullptr);
+    }
+
     try {
-        Program program("Nuclear Power Plants");
+        Program program("Nuclear Power Plants", serialLoading ? 0 : AssetLoader::defaultWorkerCount(), exposureRasters);
         program.renderLoop();
     } catch (const std::exception& e) {
         std::cerr << "Exception: " << e.what() << "\n";
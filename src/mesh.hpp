@@ -3,6 +3,8 @@
 #include <shader.hpp>
 
 #include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -14,58 +16,156 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// Vertex as uploaded: the normal as signed normalized 10:10:10:2
+// (GL_INT_2_10_10_10_REV) and the texture coordinates as half floats,
+// 20 bytes instead of 32
+struct PackedVertex {
+    glm::vec3 Position;
+    uint32_t Normal;
+    uint16_t TexCoords[2];
+};
+
+// Per-instance data for drawing a mesh many times in one call, read from
+// attribute locations 3 to 7
+struct MeshInstance {
+    glm::mat4 model;
+    glm::vec4 highlight; // mixed into the texture colour, alpha 0 for none
+};
+
 struct TextureGL {
     unsigned int id;
     string type;
     string path;
 }; 
 
+// One level of detail: a range of the mesh's index buffer, drawn against
+// the shared vertex buffer
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+};
+
+// A mesh in its GPU layout, as MeshOptimizer produces it and MeshCache
+// stores it
+struct MeshData {
+    vector<PackedVertex> vertices;
+    vector<uint8_t>      indices;   // indexSize bytes per index
+    unsigned int         indexSize = sizeof(unsigned int);
+    vector<MeshLod>      lods;      // finest first, empty for one level
+    vector<TextureGL>    textures;
+
+    size_t indexCount() const { return indices.size() / indexSize; }
+};
+
 class Mesh {
     public:
         // mesh data
-        vector<Vertex>       vertices;
-        vector<unsigned int> indices;
         vector<TextureGL>      textures;
 
-        Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<TextureGL> textures)
+        Mesh(const MeshData &data)
+            : Mesh(data.vertices.data(), data.vertices.size(), data.indices.data(), data.indexCount(), data.indexSize, data.lods, data.textures)
+        {
+        }
+        // uploads straight from the given arrays, e.g. a mapped mesh cache,
+        // without keeping a copy; indexSize is 2 or 4 bytes and no lods
+        // means the whole index buffer is the only level
+        Mesh(const PackedVertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount, unsigned int indexSize, vector<MeshLod> lods, vector<TextureGL> textures)
         {
-            this->vertices = vertices;
-            this->indices = indices;
             this->textures = textures;
+            this->lods = lods;
+            if (this->lods.empty())
+                this->lods.push_back({ 0, static_cast<uint32_t>(indexCount) });
 
-            setupMesh();
+            setupMesh(vertexData, vertexCount, indexData, indexCount, indexSize);
         }
 
         void Draw(Shader &shader) 
         {
-            unsigned int diffuseNr = 1;
-            unsigned int specularNr = 1;
-            for(unsigned int i = 0; i < textures.size(); i++)
-            {
-                glActiveTexture(GL_TEXTURE0 + i);
-                string number;
-                string name = textures[i].type;
-                if(name == "texture_diffuse")
-                    number = std::to_string(diffuseNr++);
-                else if(name == "texture_specular")
-                    number = std::to_string(specularNr++);
-
-                shader.setInt(("material." + name + number).c_str(), i);
-                glBindTexture(GL_TEXTURE_2D, textures[i].id);
-            }
-            glActiveTexture(GL_TEXTURE0);
+            bindTextures(shader);
 
             glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+            glDrawElements(GL_TRIANGLES, lods[0].indexCount, indexType, indexOffset(lods[0]));
             glBindVertexArray(0);
         }  
 
+        // draws instanceCount copies placed by the buffer given to setInstanceBuffer
+        void DrawInstanced(Shader &shader, GLsizei instanceCount, size_t lod = 0)
+        {
+            bindTextures(shader);
+
+            const MeshLod &level = lods[std::min(lod, lods.size() - 1)];
+            glBindVertexArray(VAO);
+            glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, indexType, indexOffset(level), instanceCount);
+            glBindVertexArray(0);
+        }
+
+        size_t getLodCount() const { return lods.size(); }
+        GLsizei getTriangleCount(size_t lod) const { return lods[std::min(lod, lods.size() - 1)].indexCount / 3; }
+
+        // reads MeshInstance attributes from buffer, one per instance,
+        // starting at firstInstance; GL 3.3 has no base instance for draws
+        void setInstanceBuffer(GLuint buffer, size_t firstInstance = 0)
+        {
+            const size_t base = firstInstance * sizeof(MeshInstance);
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            // a mat4 attribute takes one location per column
+            for(unsigned int column = 0; column < 4; column++)
+            {
+                glEnableVertexAttribArray(3 + column);
+                glVertexAttribPointer(3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance),
+                    (void*)(base + offsetof(MeshInstance, model) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(3 + column, 1);
+            }
+            glEnableVertexAttribArray(7);
+            glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(MeshInstance), (void*)(base + offsetof(MeshInstance, highlight)));
+            glVertexAttribDivisor(7, 1);
+            glBindVertexArray(0);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
 
     private:
         unsigned int VAO, VBO, EBO;
+        GLenum indexType = GL_UNSIGNED_INT;
+        unsigned int indexSize = sizeof(unsigned int);
+        vector<MeshLod> lods;
+        // sampler uniform of each texture, named once rather than every draw
+        vector<string> samplerNames;
 
-        void setupMesh()
+        const void *indexOffset(const MeshLod &level) const
         {
+            return reinterpret_cast<const void*>(size_t(level.firstIndex) * indexSize);
+        }
+
+        void bindTextures(Shader &shader)
+        {
+            for(unsigned int i = 0; i < textures.size(); i++)
+            {
+                glActiveTexture(GL_TEXTURE0 + i);
+                shader.setInt(samplerNames[i], i);
+                glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            }
+            glActiveTexture(GL_TEXTURE0);
+        }
+
+        void setupMesh(const PackedVertex *vertexData, size_t vertexCount, const void *indexData, size_t indexCount, unsigned int indexSize)
+        {
+            this->indexSize = indexSize;
+            indexType = indexSize == sizeof(uint16_t) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+
+            unsigned int diffuseNr = 1;
+            unsigned int specularNr = 1;
+            for(const TextureGL &texture : textures)
+            {
+                string number;
+                if(texture.type == "texture_diffuse")
+                    number = std::to_string(diffuseNr++);
+                else if(texture.type == "texture_specular")
+                    number = std::to_string(specularNr++);
+                samplerNames.push_back("material." + texture.type + number);
+            }
+
             glGenVertexArrays(1, &VAO);
             glGenBuffers(1, &VBO);
             glGenBuffers(1, &EBO);
@@ -73,21 +173,21 @@ class Mesh {
             glBindVertexArray(VAO);
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);  
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(PackedVertex), vertexData, GL_STATIC_DRAW);  
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), 
-                        &indices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * indexSize, 
+                        indexData, GL_STATIC_DRAW);
 
             // vertex positions
             glEnableVertexAttribArray(0);	
-            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-            // vertex normals
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)0);
+            // vertex normals, the shader only reads xyz
             glEnableVertexAttribArray(1);	
-            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+            glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
             // vertex texture coords
             glEnableVertexAttribArray(2);	
-            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+            glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, TexCoords));
 
             glBindVertexArray(0);
         }  
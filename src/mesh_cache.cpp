@@ -0,0 +1,199 @@
+#include "mesh_cache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<PackedVertex>::value, "PackedVertex is stored byte for byte");
+
+namespace {
+    const char magic[4] = { 'N', 'M', 'S', 'H' };
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t sourceHash;
+        uint64_t sourceSize;
+        uint32_t vertexSize;
+        uint32_t meshCount;
+    };
+
+    struct MeshHeader {
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t indexSize;
+        uint32_t lodCount;
+        uint32_t reserved;
+    };
+
+    size_t alignUp(size_t offset) { return (offset + 7) & ~size_t(7); }
+
+    // Bounds-checked walk over the mapping
+    class Cursor {
+    public:
+        Cursor(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+        bool has(size_t bytes) const { return bytes <= size - offset; }
+        const uint8_t* take(size_t bytes) {
+            if (!has(bytes))
+                return nullptr;
+            const uint8_t* start = data + offset;
+            offset += bytes;
+            return start;
+        }
+        template <typename T>
+        bool read(T& value) {
+            const uint8_t* bytes = take(sizeof(T));
+            if (bytes)
+                std::memcpy(&value, bytes, sizeof(T));
+            return bytes != nullptr;
+        }
+        bool align() {
+            size_t aligned = alignUp(offset);
+            if (aligned > size)
+                return false;
+            offset = aligned;
+            return true;
+        }
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t offset = 0;
+    };
+}
+
+namespace MeshCache {
+    uint64_t hashBytes(const uint8_t* data, size_t size) {
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    bool Reader::open(const std::string& path, uint64_t sourceHash, uint64_t sourceSize) {
+        meshes.clear();
+        if (!file.open(path))
+            return false;
+
+        Cursor cursor(file.data(), file.size());
+        Header header;
+        if (!cursor.read(header) || std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+            header.version != version || header.vertexSize != sizeof(PackedVertex) ||
+            header.sourceHash != sourceHash || header.sourceSize != sourceSize) {
+            file.close();
+            return false;
+        }
+
+        for (uint32_t i = 0; i < header.meshCount; ++i) {
+            MeshHeader meshHeader;
+            MeshView mesh;
+            bool valid = cursor.read(meshHeader);
+
+            for (uint32_t t = 0; valid && t < meshHeader.textureCount; ++t) {
+                uint32_t typeLength = 0, pathLength = 0;
+                valid = cursor.read(typeLength) && cursor.read(pathLength);
+                const uint8_t* type = valid ? cursor.take(typeLength) : nullptr;
+                const uint8_t* texturePath = type ? cursor.take(pathLength) : nullptr;
+                valid = texturePath != nullptr;
+                if (valid) {
+                    mesh.textures.push_back({ std::string(reinterpret_cast<const char*>(type), typeLength),
+                                              std::string(reinterpret_cast<const char*>(texturePath), pathLength) });
+                }
+            }
+
+            for (uint32_t l = 0; valid && l < meshHeader.lodCount; ++l) {
+                MeshLod lod;
+                valid = cursor.read(lod) && lod.firstIndex <= meshHeader.indexCount &&
+                        lod.indexCount <= meshHeader.indexCount - lod.firstIndex;
+                if (valid)
+                    mesh.lods.push_back(lod);
+            }
+
+            // The mapping is page aligned, so aligned offsets are aligned addresses
+            valid = valid && cursor.align() && (meshHeader.indexSize == 2 || meshHeader.indexSize == 4);
+            const uint8_t* vertices = valid ? cursor.take(size_t(meshHeader.vertexCount) * sizeof(PackedVertex)) : nullptr;
+            const uint8_t* indices = vertices ? cursor.take(size_t(meshHeader.indexCount) * meshHeader.indexSize) : nullptr;
+            if (!indices) {
+                std::cerr << "[MeshCache] ERROR: " << path << " is truncated or damaged\n";
+                meshes.clear();
+                file.close();
+                return false;
+            }
+
+            mesh.vertices = reinterpret_cast<const PackedVertex*>(vertices);
+            mesh.vertexCount = meshHeader.vertexCount;
+            mesh.indices = indices;
+            mesh.indexCount = meshHeader.indexCount;
+            mesh.indexSize = meshHeader.indexSize;
+            meshes.push_back(std::move(mesh));
+        }
+        return true;
+    }
+
+    bool write(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, const std::vector<MeshData>& meshes) {
+        const std::string temporaryPath = path + ".tmp";
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[MeshCache] ERROR: cannot write " << temporaryPath << "\n";
+            return false;
+        }
+
+        Header header;
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.sourceHash = sourceHash;
+        header.sourceSize = sourceSize;
+        header.vertexSize = sizeof(PackedVertex);
+        header.meshCount = static_cast<uint32_t>(meshes.size());
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        size_t offset = sizeof(header);
+
+        auto put = [&](const void* data, size_t bytes) {
+            out.write(static_cast<const char*>(data), bytes);
+            offset += bytes;
+        };
+
+        for (const MeshData& mesh : meshes) {
+            MeshHeader meshHeader = { static_cast<uint32_t>(mesh.vertices.size()), static_cast<uint32_t>(mesh.indexCount()),
+                                      static_cast<uint32_t>(mesh.textures.size()), mesh.indexSize,
+                                      static_cast<uint32_t>(mesh.lods.size()), 0 };
+            put(&meshHeader, sizeof(meshHeader));
+
+            for (const TextureGL& texture : mesh.textures) {
+                uint32_t lengths[2] = { static_cast<uint32_t>(texture.type.size()), static_cast<uint32_t>(texture.path.size()) };
+                put(lengths, sizeof(lengths));
+                put(texture.type.data(), texture.type.size());
+                put(texture.path.data(), texture.path.size());
+            }
+
+            put(mesh.lods.data(), mesh.lods.size() * sizeof(MeshLod));
+
+            const char padding[8] = {};
+            put(padding, alignUp(offset) - offset);
+            put(mesh.vertices.data(), mesh.vertices.size() * sizeof(PackedVertex));
+            put(mesh.indices.data(), mesh.indices.size());
+        }
+
+        out.close();
+        if (!out) {
+            std::cerr << "[MeshCache] ERROR: cannot write " << temporaryPath << "\n";
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+
+        // rename does not replace an existing file everywhere
+        std::remove(path.c_str());
+        if (std::rename(temporaryPath.c_str(), path.c_str()) != 0) {
+            std::cerr << "[MeshCache] ERROR: cannot rename " << temporaryPath << "\n";
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+        return true;
+    }
+}
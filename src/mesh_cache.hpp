@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "mapped_file.hpp"
+#include "mesh.hpp"
+
+// Binary copy of a model as Model builds it from Assimp: every mesh's
+// optimized PackedVertex array, index buffer with its levels of detail and
+// texture references. The
+// file starts with a header holding a format version, the size of
+// PackedVertex and the size and hash of the source file; a cache that
+// disagrees with any of them is stale.
+//
+// Layout, native byte order:
+//   Header
+//   per mesh: MeshHeader, textures as (type length, path length, type, path),
+//             lods as (first index, index count), padding to 8 bytes,
+//             vertices, indices
+namespace MeshCache {
+    constexpr uint32_t version = 3;
+
+    // FNV-1a
+    uint64_t hashBytes(const uint8_t* data, size_t size);
+
+    struct TextureRef {
+        std::string type;
+        std::string path;
+    };
+
+    // Points into the reader's mapping
+    struct MeshView {
+        const PackedVertex* vertices = nullptr;
+        uint32_t vertexCount = 0;
+        const void* indices = nullptr;
+        uint32_t indexCount = 0;
+        uint32_t indexSize = 0; // 2 or 4 bytes
+        std::vector<MeshLod> lods;
+        std::vector<TextureRef> textures;
+    };
+
+    class Reader {
+    public:
+        // Maps the cache and checks it against the source; false if it is
+        // missing, stale or damaged
+        bool open(const std::string& path, uint64_t sourceHash, uint64_t sourceSize);
+
+        // Valid while the reader is open
+        const std::vector<MeshView>& getMeshes() const { return meshes; }
+
+    private:
+        MappedFile file;
+        std::vector<MeshView> meshes;
+    };
+
+    // Writes to a temporary file first so a reader never sees half a cache
+    bool write(const std::string& path, uint64_t sourceHash, uint64_t sourceSize, const std::vector<MeshData>& meshes);
+}
@@ -0,0 +1,364 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+#include <glm/gtc/packing.hpp>
+
+#include "mesh_simplifier.hpp"
+
+namespace {
+    // Forsyth scoring, tuned for a 32-entry LRU; a smaller FIFO does almost
+    // as well on the same order
+    constexpr int scoreCacheSize = 32;
+    constexpr float cacheDecayPower = 1.5f;
+    constexpr float lastTriangleScore = 0.75f;
+    constexpr float valenceBoostScale = 2.0f;
+    constexpr float valenceBoostPower = 0.5f;
+
+    // Overdraw clusters start at a cache-cold triangle once they hold this
+    // many triangles, and the overdraw order is dropped if ACMR grows by
+    // more than the threshold
+    constexpr size_t minClusterTriangles = 64;
+    constexpr float overdrawAcmrThreshold = 1.05f;
+
+    // A level that keeps more than this share of the one before is not worth
+    // its index buffer
+    constexpr float minLodReduction = 0.9f;
+
+    constexpr unsigned int invalid = std::numeric_limits<unsigned int>::max();
+
+    struct PackedVertexHash {
+        size_t operator()(const PackedVertex& vertex) const {
+            uint32_t words[sizeof(PackedVertex) / 4];
+            std::memcpy(words, &vertex, sizeof(words));
+            size_t hash = 0;
+            for (uint32_t word : words)
+                hash = (hash ^ word) * 0x100000001b3ull;
+            return hash;
+        }
+    };
+
+    struct PackedVertexEqual {
+        bool operator()(const PackedVertex& a, const PackedVertex& b) const {
+            return std::memcmp(&a, &b, sizeof(PackedVertex)) == 0;
+        }
+    };
+
+    static_assert(sizeof(PackedVertex) == 20, "PackedVertex has no padding");
+
+    float vertexScore(int cachePosition, unsigned int remainingTriangles) {
+        if (remainingTriangles == 0)
+            return -1.0f;
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            // the last triangle's vertices score the same whatever their order
+            if (cachePosition < 3)
+                score = lastTriangleScore;
+            else
+                score = std::pow(1.0f - float(cachePosition - 3) / (scoreCacheSize - 3), cacheDecayPower);
+        }
+        return score + valenceBoostScale * std::pow(float(remainingTriangles), -valenceBoostPower);
+    }
+
+    // Tom Forsyth, "Linear-Speed Vertex Cache Optimisation"
+    std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount) {
+        const size_t triangleCount = indices.size() / 3;
+
+        // triangles of each vertex; the first live[v] of them are not emitted yet
+        std::vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (unsigned int index : indices)
+            ++offsets[index + 1];
+        for (size_t v = 0; v < vertexCount; ++v)
+            offsets[v + 1] += offsets[v];
+        std::vector<unsigned int> live(vertexCount, 0);
+        std::vector<unsigned int> adjacency(indices.size());
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                adjacency[offsets[v] + live[v]++] = static_cast<unsigned int>(t);
+            }
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> score(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v)
+            score[v] = vertexScore(-1, live[v]);
+
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> cache, nextCache;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+
+        auto triangleScore = [&](unsigned int t) {
+            return score[indices[t * 3]] + score[indices[t * 3 + 1]] + score[indices[t * 3 + 2]];
+        };
+
+        size_t nextUnemitted = 0;
+        unsigned int best = triangleCount ? 0 : invalid;
+        while (best != invalid) {
+            emitted[best] = true;
+            const unsigned int* corners = &indices[best * 3];
+            nextCache.assign(corners, corners + 3);
+
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = corners[k];
+                result.push_back(v);
+                unsigned int* triangles = &adjacency[offsets[v]];
+                unsigned int* found = std::find(triangles, triangles + live[v], best);
+                std::swap(*found, triangles[--live[v]]);
+            }
+
+            for (unsigned int v : cache) {
+                if (v != corners[0] && v != corners[1] && v != corners[2])
+                    nextCache.push_back(v);
+            }
+            for (size_t i = 0; i < nextCache.size(); ++i) {
+                unsigned int v = nextCache[i];
+                cachePosition[v] = i < size_t(scoreCacheSize) ? int(i) : -1;
+                score[v] = vertexScore(cachePosition[v], live[v]);
+            }
+            if (nextCache.size() > size_t(scoreCacheSize))
+                nextCache.resize(scoreCacheSize);
+            cache.swap(nextCache);
+
+            // the best triangle touching the cache, or else the next one left
+            best = invalid;
+            float bestScore = -std::numeric_limits<float>::max();
+            for (unsigned int v : cache) {
+                for (unsigned int i = 0; i < live[v]; ++i) {
+                    unsigned int t = adjacency[offsets[v] + i];
+                    float candidate = triangleScore(t);
+                    if (candidate > bestScore) {
+                        bestScore = candidate;
+                        best = t;
+                    }
+                }
+            }
+            if (best == invalid) {
+                while (nextUnemitted < triangleCount && emitted[nextUnemitted])
+                    ++nextUnemitted;
+                if (nextUnemitted < triangleCount)
+                    best = static_cast<unsigned int>(nextUnemitted);
+            }
+        }
+        return result;
+    }
+
+    // Indices [first, first + count) of data, widened to 32 bits
+    std::vector<unsigned int> readIndices(const MeshData& data, size_t first, size_t count) {
+        std::vector<unsigned int> indices(count);
+        for (size_t i = 0; i < count; ++i) {
+            if (data.indexSize == sizeof(uint16_t)) {
+                uint16_t index;
+                std::memcpy(&index, &data.indices[(first + i) * sizeof(index)], sizeof(index));
+                indices[i] = index;
+            } else {
+                std::memcpy(&indices[i], &data.indices[(first + i) * sizeof(unsigned int)], sizeof(unsigned int));
+            }
+        }
+        return indices;
+    }
+
+    // Appends indices to data at its index size
+    void appendIndices(MeshData& data, const std::vector<unsigned int>& indices) {
+        size_t offset = data.indices.size();
+        data.indices.resize(offset + indices.size() * data.indexSize);
+        if (data.indexSize == sizeof(uint16_t)) {
+            for (size_t i = 0; i < indices.size(); ++i) {
+                uint16_t index = static_cast<uint16_t>(indices[i]);
+                std::memcpy(&data.indices[offset + i * sizeof(index)], &index, sizeof(index));
+            }
+        } else {
+            std::memcpy(&data.indices[offset], indices.data(), indices.size() * sizeof(unsigned int));
+        }
+    }
+
+    // Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+    // Locality and Reduced Overdraw": cut the cache order into clusters at
+    // cache-cold triangles and draw the clusters that face away from the
+    // centre first, so the outer shell tends to occlude what is inside
+    std::vector<unsigned int> optimizeOverdraw(const std::vector<unsigned int>& indices, const std::vector<PackedVertex>& vertices) {
+        const size_t triangleCount = indices.size() / 3;
+
+        std::vector<size_t> clusterStarts;
+        std::vector<unsigned int> fifo(MeshOptimizer::cacheSize, invalid);
+        size_t fifoHead = 0;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            int misses = 0;
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                if (std::find(fifo.begin(), fifo.end(), v) == fifo.end()) {
+                    fifo[fifoHead] = v;
+                    fifoHead = (fifoHead + 1) % fifo.size();
+                    ++misses;
+                }
+            }
+            if (clusterStarts.empty() || (misses == 3 && t - clusterStarts.back() >= minClusterTriangles))
+                clusterStarts.push_back(t);
+        }
+        clusterStarts.push_back(triangleCount);
+
+        const size_t clusterCount = clusterStarts.size() - 1;
+        std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+        std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+        std::vector<float> clusterArea(clusterCount, 0.0f);
+        glm::vec3 meshCentroid(0.0f);
+        float meshArea = 0.0f;
+
+        for (size_t c = 0; c < clusterCount; ++c) {
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; ++t) {
+                const glm::vec3& a = vertices[indices[t * 3]].Position;
+                const glm::vec3& b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3& p = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 normal = glm::cross(b - a, p - a); // length is twice the area
+                float area = glm::length(normal);
+                clusterNormal[c] += normal;
+                clusterCentroid[c] += (a + b + p) * (area / 3.0f);
+                clusterArea[c] += area;
+            }
+            meshCentroid += clusterCentroid[c];
+            meshArea += clusterArea[c];
+        }
+        if (meshArea > 0.0f)
+            meshCentroid /= meshArea;
+
+        std::vector<float> sortKey(clusterCount, 0.0f);
+        for (size_t c = 0; c < clusterCount; ++c) {
+            float normalLength = glm::length(clusterNormal[c]);
+            if (clusterArea[c] > 0.0f && normalLength > 0.0f)
+                sortKey[c] = glm::dot(clusterCentroid[c] / clusterArea[c] - meshCentroid, clusterNormal[c] / normalLength);
+        }
+
+        std::vector<size_t> order(clusterCount);
+        for (size_t c = 0; c < clusterCount; ++c)
+            order[c] = c;
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return sortKey[a] > sortKey[b]; });
+
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        for (size_t c : order)
+            result.insert(result.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+        return result;
+    }
+}
+
+namespace MeshOptimizer {
+    float computeAcmr(const unsigned int* indices, size_t indexCount, size_t vertexCount) {
+        if (indexCount < 3)
+            return 0.0f;
+
+        // a vertex is cached while fewer than cacheSize misses came after it
+        std::vector<size_t> missedAt(vertexCount, 0);
+        size_t misses = 0;
+        for (size_t i = 0; i < indexCount; ++i) {
+            size_t& at = missedAt[indices[i]];
+            if (at == 0 || misses - at >= cacheSize)
+                at = ++misses;
+        }
+        return float(misses) / float(indexCount / 3);
+    }
+
+    void accumulate(Stats& total, const Stats& mesh) {
+        const size_t triangles = total.indexCount / 3 + mesh.indexCount / 3;
+        if (triangles > 0)
+            total.acmr = (total.acmr * (total.indexCount / 3) + mesh.acmr * (mesh.indexCount / 3)) / triangles;
+        total.vertexCount += mesh.vertexCount;
+        total.indexCount += mesh.indexCount;
+        total.bytes += mesh.bytes;
+    }
+
+    PackedVertex pack(const Vertex& vertex) {
+        PackedVertex packed;
+        packed.Position = vertex.Position;
+        packed.Normal = glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f));
+        packed.TexCoords[0] = glm::packHalf1x16(vertex.TexCoords.x);
+        packed.TexCoords[1] = glm::packHalf1x16(vertex.TexCoords.y);
+        return packed;
+    }
+
+    MeshData optimize(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices, Stats* before, Stats* after) {
+        if (before) {
+            before->vertexCount = vertices.size();
+            before->indexCount = indices.size();
+            before->bytes = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+            before->acmr = computeAcmr(indices.data(), indices.size(), vertices.size());
+        }
+
+        // weld what packing made identical, dropping triangles that collapse
+        std::vector<PackedVertex> welded;
+        std::vector<unsigned int> remap(vertices.size());
+        std::unordered_map<PackedVertex, unsigned int, PackedVertexHash, PackedVertexEqual> unique;
+        unique.reserve(vertices.size());
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            PackedVertex packed = pack(vertices[v]);
+            auto inserted = unique.emplace(packed, static_cast<unsigned int>(welded.size()));
+            if (inserted.second)
+                welded.push_back(packed);
+            remap[v] = inserted.first->second;
+        }
+
+        std::vector<unsigned int> weldedIndices;
+        weldedIndices.reserve(indices.size());
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            unsigned int a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (a != b && b != c && a != c) {
+                weldedIndices.push_back(a);
+                weldedIndices.push_back(b);
+                weldedIndices.push_back(c);
+            }
+        }
+
+        std::vector<unsigned int> ordered = optimizeVertexCache(weldedIndices, welded.size());
+        std::vector<unsigned int> outsideIn = optimizeOverdraw(ordered, welded);
+        if (computeAcmr(outsideIn.data(), outsideIn.size(), welded.size()) <=
+            computeAcmr(ordered.data(), ordered.size(), welded.size()) * overdrawAcmrThreshold)
+            ordered.swap(outsideIn);
+
+        // first use order, which also drops vertices no triangle references
+        MeshData data;
+        std::fill(remap.begin(), remap.end(), invalid);
+        remap.resize(welded.size(), invalid);
+        for (unsigned int& index : ordered) {
+            if (remap[index] == invalid) {
+                remap[index] = static_cast<unsigned int>(data.vertices.size());
+                data.vertices.push_back(welded[index]);
+            }
+            index = remap[index];
+        }
+
+        data.indexSize = data.vertices.size() <= 65536 ? sizeof(uint16_t) : sizeof(unsigned int);
+        appendIndices(data, ordered);
+
+        if (after) {
+            after->vertexCount = data.vertices.size();
+            after->indexCount = ordered.size();
+            after->bytes = data.vertices.size() * sizeof(PackedVertex) + data.indices.size();
+            after->acmr = computeAcmr(ordered.data(), ordered.size(), data.vertices.size());
+        }
+        return data;
+    }
+
+    void generateLods(MeshData& data) {
+        const size_t fullCount = data.indexCount();
+        data.lods.assign(1, { 0, static_cast<uint32_t>(fullCount) });
+
+        std::vector<unsigned int> previous = readIndices(data, 0, fullCount);
+        while (data.lods.size() < lodCount) {
+            size_t target = static_cast<size_t>(previous.size() / 3 * lodTriangleRatio) * 3;
+            std::vector<unsigned int> simplified = MeshSimplifier::simplify(data.vertices, previous, target);
+            if (simplified.empty() || simplified.size() > previous.size() * minLodReduction)
+                break;
+
+            simplified = optimizeVertexCache(simplified, data.vertices.size());
+            data.lods.push_back({ static_cast<uint32_t>(data.indexCount()), static_cast<uint32_t>(simplified.size()) });
+            appendIndices(data, simplified);
+            previous.swap(simplified);
+        }
+    }
+}
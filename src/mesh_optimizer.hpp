@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.hpp"
+
+// Load-time preparation of imported meshes for drawing:
+//   1. pack normals to 10:10:10:2 and texture coordinates to half floats
+//   2. weld vertices that are identical once packed
+//   3. order triangles for the post-transform vertex cache (Forsyth)
+//   4. reorder clusters of those triangles outside-in to cut overdraw,
+//      unless that costs more than a few percent of the cache gain
+//   5. renumber vertices in order of first use for fetch locality
+//   6. use 16-bit indices when the mesh has at most 65536 vertices
+// generateLods then adds coarser levels of detail over the same vertices.
+namespace MeshOptimizer {
+    // FIFO size assumed when measuring ACMR
+    constexpr unsigned int cacheSize = 16;
+
+    // Levels including the full mesh, each with a quarter of the triangles
+    // of the one before, i.e. half the edge length
+    constexpr size_t lodCount = 4;
+    constexpr float lodTriangleRatio = 0.25f;
+
+    struct Stats {
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        size_t bytes = 0;  // vertex plus index buffer
+        float acmr = 0.0f; // vertex shader runs per triangle, 0.5 to 3
+    };
+
+    // Average cache miss ratio of a triangle list through a FIFO cache
+    float computeAcmr(const unsigned int* indices, size_t indexCount, size_t vertexCount);
+
+    // Adds a mesh to a model total, weighting ACMR by triangle count
+    void accumulate(Stats& total, const Stats& mesh);
+
+    PackedVertex pack(const Vertex& vertex);
+
+    // Stats of the mesh as given and as returned are written when requested;
+    // textures are left to the caller
+    MeshData optimize(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                      Stats* before = nullptr, Stats* after = nullptr);
+
+    // Simplifies the optimized mesh into up to lodCount levels sharing its
+    // vertex buffer; stops early once the simplifier makes no progress
+    void generateLods(MeshData& data);
+}
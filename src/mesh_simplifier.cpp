@@ -0,0 +1,337 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <queue>
+#include <unordered_map>
+
+#include <glm/gtc/packing.hpp>
+
+namespace {
+    // Open borders weigh this much more than the surface
+    constexpr double borderWeight = 10.0;
+    // Smallest cosine between a triangle's normal before and after a collapse
+    constexpr float minNormalCosine = 0.2f;
+
+    // Symmetric 4x4 matrix of the summed squared distances to planes
+    struct Quadric {
+        double a11 = 0, a12 = 0, a13 = 0, a14 = 0;
+        double a22 = 0, a23 = 0, a24 = 0;
+        double a33 = 0, a34 = 0;
+        double a44 = 0;
+
+        static Quadric plane(const glm::vec3& normal, float distance, double weight) {
+            const double a = normal.x, b = normal.y, c = normal.z, d = distance;
+            Quadric q;
+            q.a11 = weight * a * a; q.a12 = weight * a * b; q.a13 = weight * a * c; q.a14 = weight * a * d;
+            q.a22 = weight * b * b; q.a23 = weight * b * c; q.a24 = weight * b * d;
+            q.a33 = weight * c * c; q.a34 = weight * c * d;
+            q.a44 = weight * d * d;
+            return q;
+        }
+
+        Quadric& operator+=(const Quadric& q) {
+            a11 += q.a11; a12 += q.a12; a13 += q.a13; a14 += q.a14;
+            a22 += q.a22; a23 += q.a23; a24 += q.a24;
+            a33 += q.a33; a34 += q.a34;
+            a44 += q.a44;
+            return *this;
+        }
+
+        double error(const glm::vec3& p) const {
+            const double x = p.x, y = p.y, z = p.z;
+            double e = a11 * x * x + 2 * a12 * x * y + 2 * a13 * x * z + 2 * a14 * x
+                     + a22 * y * y + 2 * a23 * y * z + 2 * a24 * y
+                     + a33 * z * z + 2 * a34 * z
+                     + a44;
+            return e > 0.0 ? e : 0.0;
+        }
+    };
+
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+    // Hashes the bits of a position, which the map compares with ==, so -0
+    // is hashed as 0 to keep positions that compare equal in one bucket
+    struct PositionHash {
+        size_t operator()(const glm::vec3& p) const {
+            const glm::vec3 canonical(p.x == 0.0f ? 0.0f : p.x, p.y == 0.0f ? 0.0f : p.y, p.z == 0.0f ? 0.0f : p.z);
+            uint32_t words[3];
+            std::memcpy(words, &canonical, sizeof(words));
+            return (size_t(words[0]) * 73856093u) ^ (size_t(words[1]) * 19349663u) ^ (size_t(words[2]) * 83492791u);
+        }
+    };
+
+    class Simplifier {
+    public:
+        Simplifier(const std::vector<PackedVertex>& vertices, const std::vector<unsigned int>& indices)
+            : vertices(vertices), corners(indices) {
+            weldPositions();
+            buildTriangles();
+            buildQuadrics();
+        }
+
+        std::vector<unsigned int> run(size_t targetIndexCount) {
+            for (unsigned int p = 0; p < positions.size(); ++p) {
+                for (unsigned int n : neighbours(p)) {
+                    if (n > p)
+                        push(p, n);
+                }
+            }
+
+            while (liveTriangles * 3 > targetIndexCount && !queue.empty()) {
+                Collapse collapse = queue.top();
+                queue.pop();
+                if (!alive[collapse.from] || !alive[collapse.to] ||
+                    version[collapse.from] != collapse.fromVersion || version[collapse.to] != collapse.toVersion)
+                    continue;
+                if (allowed(collapse.from, collapse.to))
+                    apply(collapse.from, collapse.to);
+            }
+
+            std::vector<unsigned int> result;
+            result.reserve(liveTriangles * 3);
+            for (size_t t = 0; t < triangleAlive.size(); ++t) {
+                if (triangleAlive[t])
+                    result.insert(result.end(), corners.begin() + t * 3, corners.begin() + t * 3 + 3);
+            }
+            return result;
+        }
+
+    private:
+        const std::vector<PackedVertex>& vertices;
+        std::vector<unsigned int> corners;
+
+        // vertices sharing a position collapse together
+        std::vector<unsigned int> positionOf;
+        std::vector<glm::vec3> positions;
+        std::vector<std::vector<unsigned int>> wedges;
+
+        std::vector<std::vector<unsigned int>> triangles; // per position, may hold dead ones
+        std::vector<bool> triangleAlive;
+        size_t liveTriangles = 0;
+
+        std::vector<Quadric> quadrics;
+        std::vector<bool> border;
+        std::vector<bool> alive;
+        std::vector<unsigned int> version;
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+        unsigned int cornerPosition(size_t t, int k) const { return positionOf[corners[t * 3 + k]]; }
+
+        bool hasPosition(size_t t, unsigned int p) const {
+            return cornerPosition(t, 0) == p || cornerPosition(t, 1) == p || cornerPosition(t, 2) == p;
+        }
+
+        void weldPositions() {
+            std::unordered_map<glm::vec3, unsigned int, PositionHash> unique;
+            positionOf.resize(vertices.size());
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                auto inserted = unique.emplace(vertices[v].Position, static_cast<unsigned int>(positions.size()));
+                if (inserted.second) {
+                    positions.push_back(vertices[v].Position);
+                    wedges.emplace_back();
+                }
+                positionOf[v] = inserted.first->second;
+                wedges[positionOf[v]].push_back(static_cast<unsigned int>(v));
+            }
+            alive.assign(positions.size(), true);
+            version.assign(positions.size(), 0);
+        }
+
+        void buildTriangles() {
+            triangles.resize(positions.size());
+            triangleAlive.assign(corners.size() / 3, false);
+            for (size_t t = 0; t < triangleAlive.size(); ++t) {
+                unsigned int a = cornerPosition(t, 0), b = cornerPosition(t, 1), c = cornerPosition(t, 2);
+                if (a == b || b == c || a == c)
+                    continue;
+                triangleAlive[t] = true;
+                ++liveTriangles;
+                for (unsigned int p : { a, b, c })
+                    triangles[p].push_back(static_cast<unsigned int>(t));
+            }
+        }
+
+        void buildQuadrics() {
+            quadrics.assign(positions.size(), Quadric());
+            border.assign(positions.size(), false);
+
+            std::unordered_map<uint64_t, unsigned int> edgeUses;
+            for (size_t t = 0; t < triangleAlive.size(); ++t) {
+                if (!triangleAlive[t])
+                    continue;
+                const unsigned int p[3] = { cornerPosition(t, 0), cornerPosition(t, 1), cornerPosition(t, 2) };
+                glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+                float doubleArea = glm::length(normal);
+                if (doubleArea > 0.0f) {
+                    normal /= doubleArea;
+                    Quadric q = Quadric::plane(normal, -glm::dot(normal, positions[p[0]]), 0.5 * doubleArea);
+                    for (unsigned int corner : p)
+                        quadrics[corner] += q;
+                }
+                for (int k = 0; k < 3; ++k)
+                    ++edgeUses[edgeKey(p[k], p[(k + 1) % 3])];
+            }
+
+            // a plane through each border edge, upright on its triangle
+            for (size_t t = 0; t < triangleAlive.size(); ++t) {
+                if (!triangleAlive[t])
+                    continue;
+                const unsigned int p[3] = { cornerPosition(t, 0), cornerPosition(t, 1), cornerPosition(t, 2) };
+                glm::vec3 normal = glm::cross(positions[p[1]] - positions[p[0]], positions[p[2]] - positions[p[0]]);
+                if (glm::length(normal) == 0.0f)
+                    continue;
+                normal = glm::normalize(normal);
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int a = p[k], b = p[(k + 1) % 3];
+                    if (edgeUses[edgeKey(a, b)] != 1)
+                        continue;
+                    border[a] = border[b] = true;
+                    glm::vec3 edge = positions[b] - positions[a];
+                    glm::vec3 side = glm::cross(edge, normal);
+                    if (glm::length(side) == 0.0f)
+                        continue;
+                    side = glm::normalize(side);
+                    Quadric q = Quadric::plane(side, -glm::dot(side, positions[a]), borderWeight * glm::dot(edge, edge));
+                    quadrics[a] += q;
+                    quadrics[b] += q;
+                }
+            }
+        }
+
+        static uint64_t edgeKey(unsigned int a, unsigned int b) {
+            return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a;
+        }
+
+        std::vector<unsigned int> neighbours(unsigned int p) const {
+            std::vector<unsigned int> result;
+            for (unsigned int t : triangles[p]) {
+                if (!triangleAlive[t])
+                    continue;
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int q = cornerPosition(t, k);
+                    if (q != p)
+                        result.push_back(q);
+                }
+            }
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+            return result;
+        }
+
+        unsigned int sharedTriangles(unsigned int a, unsigned int b) const {
+            unsigned int count = 0;
+            for (unsigned int t : triangles[a])
+                count += triangleAlive[t] && hasPosition(t, b);
+            return count;
+        }
+
+        // Queues the cheaper allowed direction of the edge; a border vertex
+        // only moves along its border
+        void push(unsigned int a, unsigned int b) {
+            Quadric q = quadrics[a];
+            q += quadrics[b];
+            const bool borderEdge = sharedTriangles(a, b) == 1;
+            const bool aMoves = !border[a] || borderEdge;
+            const bool bMoves = !border[b] || borderEdge;
+            if (!aMoves && !bMoves)
+                return;
+
+            double aToB = q.error(positions[b]), bToA = q.error(positions[a]);
+            if (aMoves && (!bMoves || aToB <= bToA))
+                queue.push({ aToB, a, b, version[a], version[b] });
+            else
+                queue.push({ bToA, b, a, version[b], version[a] });
+        }
+
+        bool allowed(unsigned int from, unsigned int to) const {
+            // link condition: the vertices around both ends are only those
+            // of the triangles on the edge, otherwise the surface pinches
+            std::vector<unsigned int> fromNeighbours = neighbours(from), toNeighbours = neighbours(to);
+            std::vector<unsigned int> common;
+            std::set_intersection(fromNeighbours.begin(), fromNeighbours.end(), toNeighbours.begin(), toNeighbours.end(),
+                                  std::back_inserter(common));
+            unsigned int shared = sharedTriangles(from, to);
+            if (shared == 0 || common.size() != shared)
+                return false;
+
+            for (unsigned int t : triangles[from]) {
+                if (!triangleAlive[t] || hasPosition(t, to))
+                    continue;
+                glm::vec3 before[3], after[3];
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int p = cornerPosition(t, k);
+                    before[k] = positions[p];
+                    after[k] = p == from ? positions[to] : positions[p];
+                }
+                glm::vec3 oldNormal = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 newNormal = glm::cross(after[1] - after[0], after[2] - after[0]);
+                float oldLength = glm::length(oldNormal), newLength = glm::length(newNormal);
+                if (newLength == 0.0f)
+                    return false;
+                if (oldLength > 0.0f && glm::dot(oldNormal, newNormal) < minNormalCosine * oldLength * newLength)
+                    return false;
+            }
+            return true;
+        }
+
+        // The vertex at the target position whose normal is closest
+        unsigned int matchWedge(unsigned int vertex, unsigned int to) const {
+            glm::vec3 normal = glm::vec3(glm::unpackSnorm3x10_1x2(vertices[vertex].Normal));
+            unsigned int best = wedges[to].front();
+            float bestCosine = -2.0f;
+            for (unsigned int candidate : wedges[to]) {
+                float cosine = glm::dot(normal, glm::vec3(glm::unpackSnorm3x10_1x2(vertices[candidate].Normal)));
+                if (cosine > bestCosine) {
+                    bestCosine = cosine;
+                    best = candidate;
+                }
+            }
+            return best;
+        }
+
+        void apply(unsigned int from, unsigned int to) {
+            for (unsigned int t : triangles[from]) {
+                if (!triangleAlive[t])
+                    continue;
+                if (hasPosition(t, to)) {
+                    triangleAlive[t] = false;
+                    --liveTriangles;
+                    continue;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    if (cornerPosition(t, k) == from)
+                        corners[t * 3 + k] = matchWedge(corners[t * 3 + k], to);
+                }
+                triangles[to].push_back(t);
+            }
+
+            std::vector<unsigned int>& merged = triangles[to];
+            merged.erase(std::remove_if(merged.begin(), merged.end(), [&](unsigned int t) { return !triangleAlive[t]; }), merged.end());
+            triangles[from].clear();
+
+            quadrics[to] += quadrics[from];
+            border[to] = border[to] || border[from];
+            alive[from] = false;
+            ++version[to];
+
+            for (unsigned int n : neighbours(to))
+                push(n, to);
+        }
+    };
+}
+
+namespace MeshSimplifier {
+    std::vector<unsigned int> simplify(const std::vector<PackedVertex>& vertices, const std::vector<unsigned int>& indices,
+                                       size_t targetIndexCount) {
+        Simplifier simplifier(vertices, indices);
+        return simplifier.run(targetIndexCount);
+    }
+}
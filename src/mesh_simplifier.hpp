@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "mesh.hpp"
+
+// Quadric error edge collapse (Garland and Heckbert). Collapses always move
+// a vertex onto a neighbour rather than to a new position, so the result
+// indexes the same vertex buffer as the input and every level of detail can
+// share one. Vertices at the same position with different attributes are
+// collapsed together, each onto the neighbour's vertex with the closest
+// normal. Open borders are held by extra quadrics, and collapses that would
+// flip a triangle or make the surface non-manifold are skipped.
+namespace MeshSimplifier {
+    // Indices of at most targetIndexCount, or fewer triangles removed when
+    // no further collapse is allowed
+    std::vector<unsigned int> simplify(const std::vector<PackedVertex>& vertices, const std::vector<unsigned int>& indices,
+                                       size_t targetIndexCount);
+}
@@ -9,34 +9,33 @@ unsigned int TextureFromFileGL(const char *path, const string &directory, bool g
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    return TextureFromImageGL(ImageData::load(filename, false), path);
+}
+
+unsigned int TextureFromImageGL(const ImageData &image, const char *path) {
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data) {
+    if (image) {
         GLenum format;
-        if (nrComponents == 1)
+        if (image.channels == 1)
             format = GL_RED;
-        else if (nrComponents == 3)
+        else if (image.channels == 3)
             format = GL_RGB;
-        else if (nrComponents == 4)
+        else if (image.channels == 4)
             format = GL_RGBA;
 
         glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
         glGenerateMipmap(GL_TEXTURE_2D);
 
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
     }
     else {
         std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
     }
 
     return textureID;
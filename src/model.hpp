@@ -7,17 +7,39 @@
 
 #include <shader.hpp>
 #include <mesh.hpp>
+#include "mapped_file.hpp"
+#include "mesh_cache.hpp"
+#include "mesh_optimizer.hpp"
+#include "image_data.hpp"
 
 #include <vector>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <limits>
+#include <memory>
+#include <utility>
 
 
 using namespace std;
 
 unsigned int TextureFromFileGL(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromImageGL(const ImageData &image, const char *path);
+
+// Everything a Model needs from disk, gathered without a GL context: the
+// meshes, either viewed in the mapped cache or freshly imported, and every
+// texture they use, decoded
+struct ModelData {
+    string directory;
+    std::unique_ptr<MeshCache::Reader> cache; // set on a cache hit
+    vector<MeshData> meshes;                  // otherwise
+    vector<std::pair<string, ImageData>> images;
+
+    // whole model before and after MeshOptimizer, for the import report
+    MeshOptimizer::Stats importedStats, optimizedStats;
+};
 
 class Model {
 public:
@@ -26,8 +48,40 @@ public:
     string directory;
     bool gammaCorrection;
 
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma) {
-        loadModel(path);
+    Model(string const &path, bool gamma = false) : Model(read(path), gamma) {}
+
+    // Uploads what read gathered, on the GL thread
+    Model(ModelData data, bool gamma = false) : gammaCorrection(gamma) {
+        upload(data);
+    }
+
+    // Reads the binary cache next to the model if it still matches the source
+    // file, and otherwise imports with Assimp, optimizes and writes the cache.
+    // Also decodes the textures; needs no GL context.
+    static ModelData read(string const &path) {
+        ModelData data;
+        data.directory = path.substr(0, path.find_last_of('/'));
+
+        MappedFile source;
+        const uint64_t sourceSize = source.open(path) ? source.size() : 0;
+        const uint64_t sourceHash = sourceSize ? MeshCache::hashBytes(source.data(), source.size()) : 0;
+        source.close();
+
+        const string cachePath = path + ".meshcache";
+        data.cache = std::make_unique<MeshCache::Reader>();
+        if (sourceSize && data.cache->open(cachePath, sourceHash, sourceSize)) {
+            for (const MeshCache::MeshView &mesh : data.cache->getMeshes()) {
+                for (const MeshCache::TextureRef &texture : mesh.textures)
+                    decodeTexture(data, texture.path);
+            }
+            return data;
+        }
+        data.cache.reset();
+
+        importModel(path, data);
+        if (sourceSize && !data.meshes.empty())
+            MeshCache::write(cachePath, sourceHash, sourceSize, data.meshes);
+        return data;
     }
 
     void Draw(Shader &shader) {
@@ -35,8 +89,77 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // one instanced draw per mesh
+    void DrawInstanced(Shader &shader, GLsizei instanceCount, size_t lod = 0) {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].DrawInstanced(shader, instanceCount, lod);
+    }
+
+    void setInstanceBuffer(GLuint buffer, size_t firstInstance = 0) {
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].setInstanceBuffer(buffer, firstInstance);
+    }
+
+    // most levels of detail of any mesh; meshes with fewer repeat their last
+    size_t getLodCount() const {
+        size_t count = 1;
+        for (const Mesh &mesh : meshes)
+            count = std::max(count, mesh.getLodCount());
+        return count;
+    }
+
+    size_t getTriangleCount(size_t lod) const {
+        size_t count = 0;
+        for (const Mesh &mesh : meshes)
+            count += mesh.getTriangleCount(lod);
+        return count;
+    }
+
+    // bounding sphere in model space
+    const glm::vec3 &getBoundingCenter() const { return boundingCenter; }
+    float getBoundingRadius() const { return boundingRadius; }
+
 private:
-    void loadModel(string const &path) {
+    glm::vec3 boundingCenter = glm::vec3(0.0f);
+    float boundingRadius = 0.0f;
+
+    // sphere around the box of all vertices
+    void computeBounds(const PackedVertex *vertices, size_t vertexCount, glm::vec3 &low, glm::vec3 &high) {
+        for (size_t i = 0; i < vertexCount; i++) {
+            low = glm::min(low, vertices[i].Position);
+            high = glm::max(high, vertices[i].Position);
+        }
+        if (low.x <= high.x) {
+            boundingCenter = (low + high) * 0.5f;
+            boundingRadius = glm::length(high - low) * 0.5f;
+        }
+    }
+
+    void upload(const ModelData &data) {
+        directory = data.directory;
+
+        glm::vec3 low(std::numeric_limits<float>::max()), high(std::numeric_limits<float>::lowest());
+        if (data.cache) {
+            for (const MeshCache::MeshView &mesh : data.cache->getMeshes()) {
+                vector<TextureGL> textures;
+                for (const MeshCache::TextureRef &texture : mesh.textures)
+                    textures.push_back(loadTexture(texture.path, texture.type, data));
+                meshes.emplace_back(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.indexCount, mesh.indexSize, mesh.lods, textures);
+                computeBounds(mesh.vertices, mesh.vertexCount, low, high);
+            }
+            return;
+        }
+
+        for (const MeshData &mesh : data.meshes) {
+            vector<TextureGL> textures;
+            for (const TextureGL &texture : mesh.textures)
+                textures.push_back(loadTexture(texture.path, texture.type, data));
+            meshes.emplace_back(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indexCount(), mesh.indexSize, mesh.lods, textures);
+            computeBounds(mesh.vertices.data(), mesh.vertices.size(), low, high);
+        }
+    }
+
+    static void importModel(string const &path, ModelData &data) {
         Assimp::Importer importer;
         const aiScene *scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
 
@@ -45,22 +168,34 @@ private:
             return;
         }
 
-        directory = path.substr(0, path.find_last_of('/'));
-        processNode(scene->mRootNode, scene);
+        processNode(scene->mRootNode, scene, data);
+
+        cout << "[MeshOptimizer] " << path << ": " << data.meshes.size() << " meshes\n"
+             << "  vertices " << data.importedStats.vertexCount << " -> " << data.optimizedStats.vertexCount << "\n"
+             << "  ACMR     " << data.importedStats.acmr << " -> " << data.optimizedStats.acmr << "\n"
+             << "  bytes    " << data.importedStats.bytes << " -> " << data.optimizedStats.bytes << "\n"
+             << "  LOD triangles";
+        for (size_t lod = 0; lod < MeshOptimizer::lodCount; lod++) {
+            size_t triangles = 0;
+            for (const MeshData &mesh : data.meshes)
+                triangles += mesh.lods[std::min(lod, mesh.lods.size() - 1)].indexCount / 3;
+            cout << " " << triangles;
+        }
+        cout << endl;
     }
 
-    void processNode(aiNode *node, const aiScene *scene) {
+    static void processNode(aiNode *node, const aiScene *scene, ModelData &data) {
         for (unsigned int i = 0; i < node->mNumMeshes; i++) {
             aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.meshes.push_back(processMesh(mesh, scene, data));
         }
         for (unsigned int i = 0; i < node->mNumChildren; i++) {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene) {
+    static MeshData processMesh(aiMesh *mesh, const aiScene *scene, ModelData &model) {
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<TextureGL> textures;
@@ -99,44 +234,65 @@ private:
         }
         aiMaterial *material = scene->mMaterials[mesh->mMaterialIndex];
 
-        vector<TextureGL> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<TextureGL> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse", model);
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
 
-        vector<TextureGL> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<TextureGL> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular", model);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
 
-        std::vector<TextureGL> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<TextureGL> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal", model);
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
 
-        std::vector<TextureGL> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<TextureGL> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height", model);
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
-        return Mesh(vertices, indices, textures);
+        MeshOptimizer::Stats before, after;
+        MeshData data = MeshOptimizer::optimize(vertices, indices, &before, &after);
+        MeshOptimizer::generateLods(data);
+        data.textures = textures;
+        MeshOptimizer::accumulate(model.importedStats, before);
+        MeshOptimizer::accumulate(model.optimizedStats, after);
+        return data;
     }
 
-    vector<TextureGL> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName) {
+    // References the material's textures, the GL ids are filled in on upload
+    static vector<TextureGL> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName, ModelData &model) {
         vector<TextureGL> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++) {
             aiString str;
             mat->GetTexture(type, i, &str);
-            bool skip = false;
-
-            for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-                if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0) {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true;
-                    break;
-                }
-            }
-            if (!skip) {
-                TextureGL texture;
-                texture.id = TextureFromFileGL(str.C_Str(), this->directory, false);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);
-            }
+            textures.push_back({ 0, typeName, str.C_Str() });
+            decodeTexture(model, str.C_Str());
         }
         return textures;
     }
-};
\ No newline at end of file
+
+    // Decodes each texture file once, unflipped as the import already flips
+    // the texture coordinates
+    static void decodeTexture(ModelData &data, const string &path) {
+        for (const auto &image : data.images) {
+            if (image.first == path)
+                return;
+        }
+        data.images.emplace_back(path, ImageData::load(data.directory + '/' + path, false));
+    }
+
+    // Uploads each texture file once, later meshes share it
+    TextureGL loadTexture(const string &path, const string &typeName, const ModelData &data) {
+        for (unsigned int j = 0; j < textures_loaded.size(); j++) {
+            if (textures_loaded[j].path == path)
+                return textures_loaded[j];
+        }
+
+        TextureGL texture;
+        texture.id = 0;
+        for (const auto &image : data.images) {
+            if (image.first == path)
+                texture.id = TextureFromImageGL(image.second, path.c_str());
+        }
+        texture.type = typeName;
+        texture.path = path;
+        textures_loaded.push_back(texture);
+        return texture;
+    }
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+struct Nuclide {
+    std::string name;
+    float halfLifeDays;
+
+    Nuclide(const std::string& name, float halfLifeDays)
+        : name(name), halfLifeDays(halfLifeDays) {}
+};
+
+namespace Nuclides {
+    // The isotopes that dominate ground contamination after a reactor release
+    inline std::vector<Nuclide> getDefaultNuclides() {
+        return {
+            { "I-131",  8.02f },
+            { "Cs-134", 754.0f },
+            { "Cs-137", 11019.0f },
+            { "Sr-90",  10523.0f }
+        };
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "deposition_grid.hpp"
+#include "emission_scheduler.hpp"
+#include "particle_emission.hpp"
+#include "wind_grid.hpp"
+
+// Per-instance layout of the billboard quads the backends draw
+struct InstanceData {
+    glm::vec3 pos;
+    float intensity;
+    float scale;
+};
+
+// Common interface of the particle simulations, so the renderer and the GUI do
+// not care whether particles live on the CPU or on the GPU.
+class ParticleBackend {
+public:
+    virtual ~ParticleBackend() = default;
+
+    virtual void initialize() = 0;
+    // Releases an explosion of the given power spread over time as the
+    // profile describes; particles are created by the following updates
+    virtual void release(const glm::vec3& sourcePos, int powerMW, const ReleaseProfile& profile) = 0;
+    // Releases the whole explosion at once
+    void emit(const glm::vec3& sourcePos, int powerMW) {
+        release(sourcePos, powerMW, ReleaseProfile::instant(ParticleEmission::getReleaseCount(powerMW)));
+    }
+    virtual void update(float deltaTime, const WindGrid& windGrid) = 0;
+    // Makes this frame's particles drawable; call once per frame before draw()
+    virtual void prepareInstances() = 0;
+    virtual void draw() = 0;
+
+    // Seed of the emission random streams; the same seed and the same sequence
+    // of emissions give bit-identical particles on every backend
+    virtual void setSeed(uint64_t seed) = 0;
+
+    virtual size_t size() = 0;
+    virtual const char* getName() const = 0;
+
+    // Contamination the backend accumulates itself, shown instead of splatting
+    // the instances into the contamination texture; null if it has none
+    virtual DepositionGrid* getDeposition() { return nullptr; }
+};
@@ -0,0 +1,54 @@
+#include "particle_emission.hpp"
+
+#include <algorithm>
+
+namespace ParticleEmission {
+    uint64_t getReleaseCount(float powerMW) {
+        return static_cast<uint64_t>(std::max(powerMW * 2.5f, 1.0f));
+    }
+
+    EmissionParams computeParams(float powerMW, size_t maxParticles) {
+        float t = glm::clamp(powerMW / 10000.0f, 0.0f, 1.0f);
+
+        EmissionParams params;
+        params.minLife = 1.0f + t * 2.0f;
+        params.maxLife = 2.0f + t * 5.0f;
+        params.minSize = 0.1f + t;
+        params.maxSize = 0.45f + t;
+        params.count = static_cast<int>(std::min<uint64_t>(getReleaseCount(powerMW), maxParticles));
+
+        return params;
+    }
+
+    EmittedParticle sample(const glm::vec3& sourcePos, const EmissionParams& params,
+                           uint64_t seed, uint64_t emission, uint64_t index) {
+        RandomStream rng(seed, emission, index);
+
+        glm::vec3 posOffset = glm::vec3(
+            rng.uniform(-0.5f, 0.5f),
+            rng.uniform(-0.3f, 0.3f),
+            rng.uniform(-0.5f, 0.5f)
+        );
+
+        glm::vec3 randomWindDirection = glm::vec3(
+            rng.uniform(-1.0f, 1.0f),
+            0.0f,
+            rng.uniform(-1.0f, 1.0f)
+        );
+        glm::vec3 randomJitter = glm::vec3(
+            rng.uniform(-0.3f, 0.3f),
+            rng.uniform(-0.1f, 0.1f),
+            rng.uniform(-0.3f, 0.3f)
+        );
+
+        EmittedParticle p;
+        p.position = sourcePos + posOffset;
+        p.direction = glm::normalize(randomWindDirection + randomJitter);
+        p.velocity = rng.uniform(0.1f, 0.3f);
+        p.life = rng.uniform(params.minLife, params.maxLife);
+        p.intensity = 50.0f;
+        p.scale = rng.uniform(params.minSize, params.maxSize);
+
+        return p;
+    }
+}
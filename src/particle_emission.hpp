@@ -0,0 +1,49 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "random.hpp"
+
+// How an explosion of a given power is released. Shared by every particle
+// backend so they emit the same plume.
+struct EmissionParams {
+    float minLife;
+    float maxLife;
+    float minSize;
+    float maxSize;
+    int count;
+};
+
+struct EmittedParticle {
+    glm::vec3 position;
+    glm::vec3 direction;
+    float velocity;
+    float life;
+    float intensity;
+    float scale;
+};
+
+// Identifies every emission of a backend so that, given the same seed, the
+// n-th emission produces the same particles whatever backend or thread
+// creates them.
+struct EmissionSequence {
+    static constexpr uint64_t defaultSeed = 0x5EED;
+
+    uint64_t seed = defaultSeed;
+    uint64_t emissions = 0;
+
+    // Starts a new emission and returns its stream number
+    uint64_t next() { return emissions++; }
+};
+
+namespace ParticleEmission {
+    // Particles an explosion of the given power releases in total
+    uint64_t getReleaseCount(float powerMW);
+    EmissionParams computeParams(float powerMW, size_t maxParticles);
+    // Draws particle `index` of an emission from its own random stream
+    EmittedParticle sample(const glm::vec3& sourcePos, const EmissionParams& params,
+                           uint64_t seed, uint64_t emission, uint64_t index);
+}
@@ -0,0 +1,220 @@
+#include "particle_kernels.hpp"
+
+#include <cmath>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PARTICLE_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+    const float windBlend = 0.1f;
+
+    // Reference implementation, matches the glm code the kernels replaced.
+    void integrateScalar(const ParticleStreams &s, size_t begin, size_t end, float dt) {
+        for (size_t i = begin; i < end; ++i) {
+            if (s.windWeight[i] > 0.0f) {
+                float dx = s.directionX[i] + (s.windDirX[i] - s.directionX[i]) * windBlend;
+                float dy = s.directionY[i] + (0.0f - s.directionY[i]) * windBlend;
+                float dz = s.directionZ[i] + (s.windDirZ[i] - s.directionZ[i]) * windBlend;
+                float inverseLength = 1.0f / std::sqrt(dx * dx + dy * dy + dz * dz);
+
+                s.directionX[i] = dx * inverseLength;
+                s.directionY[i] = dy * inverseLength;
+                s.directionZ[i] = dz * inverseLength;
+                s.velocity[i] = s.velocity[i] + (s.windVelocity[i] - s.velocity[i]) * windBlend;
+            }
+
+            float step = s.velocity[i] * dt;
+            s.positionX[i] += s.directionX[i] * step;
+            s.positionY[i] += s.directionY[i] * step;
+            s.positionZ[i] += s.directionZ[i] * step;
+            s.life[i] -= dt;
+            s.intensity[i] = s.life[i];
+        }
+    }
+
+#ifdef PARTICLE_KERNELS_X86
+    // The SIMD kernels cannot run past the end of the streams, so the last
+    // partial batch is copied into local lanes, integrated with the same vector
+    // code and copied back. Every particle goes through identical arithmetic no
+    // matter where a range starts or ends.
+    template <size_t Lanes, typename Batch>
+    void integrateTail(const ParticleStreams &s, size_t begin, size_t end, float dt, Batch batch) {
+        alignas(32) float lanes[13][Lanes] = {};
+        float *mutableStreams[] = { s.positionX, s.positionY, s.positionZ, s.directionX, s.directionY, s.directionZ,
+                                    s.velocity, s.life, s.intensity };
+        const float *windStreams[] = { s.windDirX, s.windDirZ, s.windVelocity, s.windWeight };
+        size_t count = end - begin;
+
+        for (size_t k = 0; k < count; ++k) {
+            for (int a = 0; a < 9; ++a)
+                lanes[a][k] = mutableStreams[a][begin + k];
+            for (int a = 0; a < 4; ++a)
+                lanes[9 + a][k] = windStreams[a][begin + k];
+        }
+
+        ParticleStreams local = { lanes[0], lanes[1], lanes[2], lanes[3], lanes[4], lanes[5],
+                                  lanes[6], lanes[7], lanes[8], lanes[9], lanes[10], lanes[11], lanes[12] };
+        batch(local, 0, dt);
+
+        for (size_t k = 0; k < count; ++k) {
+            for (int a = 0; a < 9; ++a)
+                mutableStreams[a][begin + k] = lanes[a][k];
+        }
+    }
+
+    __attribute__((target("sse4.1")))
+    void batchSSE41(const ParticleStreams &s, size_t i, float dt) {
+        const __m128 blend = _mm_set1_ps(windBlend);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128 threeHalves = _mm_set1_ps(1.5f);
+        const __m128 delta = _mm_set1_ps(dt);
+
+        __m128 dirX = _mm_loadu_ps(s.directionX + i);
+        __m128 dirY = _mm_loadu_ps(s.directionY + i);
+        __m128 dirZ = _mm_loadu_ps(s.directionZ + i);
+        __m128 velocity = _mm_loadu_ps(s.velocity + i);
+        __m128 hasWind = _mm_cmpgt_ps(_mm_loadu_ps(s.windWeight + i), zero);
+
+        __m128 dx = _mm_add_ps(dirX, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.windDirX + i), dirX), blend));
+        __m128 dy = _mm_sub_ps(dirY, _mm_mul_ps(dirY, blend));
+        __m128 dz = _mm_add_ps(dirZ, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.windDirZ + i), dirZ), blend));
+
+        // Approximate reciprocal square root refined by one Newton-Raphson step
+        __m128 lengthSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+        __m128 r = _mm_rsqrt_ps(lengthSq);
+        r = _mm_mul_ps(r, _mm_sub_ps(threeHalves, _mm_mul_ps(_mm_mul_ps(half, lengthSq), _mm_mul_ps(r, r))));
+
+        dirX = _mm_blendv_ps(dirX, _mm_mul_ps(dx, r), hasWind);
+        dirY = _mm_blendv_ps(dirY, _mm_mul_ps(dy, r), hasWind);
+        dirZ = _mm_blendv_ps(dirZ, _mm_mul_ps(dz, r), hasWind);
+        __m128 blendedVelocity = _mm_add_ps(velocity, _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(s.windVelocity + i), velocity), blend));
+        velocity = _mm_blendv_ps(velocity, blendedVelocity, hasWind);
+
+        __m128 step = _mm_mul_ps(velocity, delta);
+        _mm_storeu_ps(s.positionX + i, _mm_add_ps(_mm_loadu_ps(s.positionX + i), _mm_mul_ps(dirX, step)));
+        _mm_storeu_ps(s.positionY + i, _mm_add_ps(_mm_loadu_ps(s.positionY + i), _mm_mul_ps(dirY, step)));
+        _mm_storeu_ps(s.positionZ + i, _mm_add_ps(_mm_loadu_ps(s.positionZ + i), _mm_mul_ps(dirZ, step)));
+        _mm_storeu_ps(s.directionX + i, dirX);
+        _mm_storeu_ps(s.directionY + i, dirY);
+        _mm_storeu_ps(s.directionZ + i, dirZ);
+        _mm_storeu_ps(s.velocity + i, velocity);
+
+        __m128 life = _mm_sub_ps(_mm_loadu_ps(s.life + i), delta);
+        _mm_storeu_ps(s.life + i, life);
+        _mm_storeu_ps(s.intensity + i, life);
+    }
+
+    __attribute__((target("sse4.1")))
+    void integrateSSE41(const ParticleStreams &s, size_t begin, size_t end, float dt) {
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4)
+            batchSSE41(s, i, dt);
+        if (i < end)
+            integrateTail<4>(s, i, end, dt, batchSSE41);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void batchAVX2(const ParticleStreams &s, size_t i, float dt) {
+        const __m256 blend = _mm256_set1_ps(windBlend);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 threeHalves = _mm256_set1_ps(1.5f);
+        const __m256 delta = _mm256_set1_ps(dt);
+
+        __m256 dirX = _mm256_loadu_ps(s.directionX + i);
+        __m256 dirY = _mm256_loadu_ps(s.directionY + i);
+        __m256 dirZ = _mm256_loadu_ps(s.directionZ + i);
+        __m256 velocity = _mm256_loadu_ps(s.velocity + i);
+        __m256 hasWind = _mm256_cmp_ps(_mm256_loadu_ps(s.windWeight + i), zero, _CMP_GT_OQ);
+
+        __m256 dx = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(s.windDirX + i), dirX), blend, dirX);
+        __m256 dy = _mm256_fnmadd_ps(dirY, blend, dirY);
+        __m256 dz = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(s.windDirZ + i), dirZ), blend, dirZ);
+
+        // Approximate reciprocal square root refined by one Newton-Raphson step
+        __m256 lengthSq = _mm256_fmadd_ps(dz, dz, _mm256_fmadd_ps(dy, dy, _mm256_mul_ps(dx, dx)));
+        __m256 r = _mm256_rsqrt_ps(lengthSq);
+        r = _mm256_mul_ps(r, _mm256_fnmadd_ps(_mm256_mul_ps(half, lengthSq), _mm256_mul_ps(r, r), threeHalves));
+
+        dirX = _mm256_blendv_ps(dirX, _mm256_mul_ps(dx, r), hasWind);
+        dirY = _mm256_blendv_ps(dirY, _mm256_mul_ps(dy, r), hasWind);
+        dirZ = _mm256_blendv_ps(dirZ, _mm256_mul_ps(dz, r), hasWind);
+        __m256 blendedVelocity = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_loadu_ps(s.windVelocity + i), velocity), blend, velocity);
+        velocity = _mm256_blendv_ps(velocity, blendedVelocity, hasWind);
+
+        __m256 step = _mm256_mul_ps(velocity, delta);
+        _mm256_storeu_ps(s.positionX + i, _mm256_fmadd_ps(dirX, step, _mm256_loadu_ps(s.positionX + i)));
+        _mm256_storeu_ps(s.positionY + i, _mm256_fmadd_ps(dirY, step, _mm256_loadu_ps(s.positionY + i)));
+        _mm256_storeu_ps(s.positionZ + i, _mm256_fmadd_ps(dirZ, step, _mm256_loadu_ps(s.positionZ + i)));
+        _mm256_storeu_ps(s.directionX + i, dirX);
+        _mm256_storeu_ps(s.directionY + i, dirY);
+        _mm256_storeu_ps(s.directionZ + i, dirZ);
+        _mm256_storeu_ps(s.velocity + i, velocity);
+
+        __m256 life = _mm256_sub_ps(_mm256_loadu_ps(s.life + i), delta);
+        _mm256_storeu_ps(s.life + i, life);
+        _mm256_storeu_ps(s.intensity + i, life);
+    }
+
+    __attribute__((target("avx2,fma")))
+    void integrateAVX2(const ParticleStreams &s, size_t begin, size_t end, float dt) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8)
+            batchAVX2(s, i, dt);
+        if (i < end)
+            integrateTail<8>(s, i, end, dt, batchAVX2);
+    }
+#endif
+}
+
+namespace ParticleKernels {
+    void integrate(Kernel kernel, const ParticleStreams &streams, size_t begin, size_t end, float deltaTime) {
+        switch (kernel) {
+#ifdef PARTICLE_KERNELS_X86
+        case Kernel::AVX2:
+            integrateAVX2(streams, begin, end, deltaTime);
+            return;
+        case Kernel::SSE41:
+            integrateSSE41(streams, begin, end, deltaTime);
+            return;
+#endif
+        default:
+            integrateScalar(streams, begin, end, deltaTime);
+            return;
+        }
+    }
+
+    bool isSupported(Kernel kernel) {
+        if (kernel == Kernel::Scalar)
+            return true;
+#ifdef PARTICLE_KERNELS_X86
+        __builtin_cpu_init();
+        if (kernel == Kernel::SSE41)
+            return __builtin_cpu_supports("sse4.1");
+        if (kernel == Kernel::AVX2)
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+        return false;
+    }
+
+    Kernel detectBestKernel() {
+        static const Kernel best = isSupported(Kernel::AVX2) ? Kernel::AVX2
+                                 : isSupported(Kernel::SSE41) ? Kernel::SSE41
+                                 : Kernel::Scalar;
+        return best;
+    }
+
+    const char *getKernelName(Kernel kernel) {
+        switch (kernel) {
+        case Kernel::AVX2:
+            return "avx2";
+        case Kernel::SSE41:
+            return "sse4.1";
+        default:
+            return "scalar";
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+
+// Raw views over the particle streams the integration kernels work on. The
+// wind* streams hold the per-particle wind target sampled beforehand; a weight
+// of 0 means the particle is outside any wind and keeps its direction.
+struct ParticleStreams {
+    float *positionX, *positionY, *positionZ;
+    float *directionX, *directionY, *directionZ;
+    float *velocity;
+    float *life;
+    float *intensity;
+    const float *windDirX, *windDirZ;
+    const float *windVelocity;
+    const float *windWeight;
+};
+
+namespace ParticleKernels {
+    enum class Kernel {
+        Scalar,
+        SSE41,
+        AVX2
+    };
+
+    // Blends every particle in [begin, end) towards its wind target, advances
+    // its position by velocity * direction * dt and ages it by dt.
+    void integrate(Kernel kernel, const ParticleStreams &streams, size_t begin, size_t end, float deltaTime);
+
+    // Best kernel the running CPU supports, detected once through CPUID.
+    Kernel detectBestKernel();
+    bool isSupported(Kernel kernel);
+    const char *getKernelName(Kernel kernel);
+}
@@ -1,171 +1,192 @@
 #include "particle_system.hpp"
+#include <algorithm>
 
-
-void ParticleSystem::initialize() {
-    initGLResources();
+void ParticleData::reserve(size_t count) {
+    for (auto* stream : { &positionX, &positionY, &positionZ, &directionX, &directionY, &directionZ,
+                          &velocity, &life, &intensity, &scale }) {
+        stream->reserve(count);
+    }
 }
 
-void ParticleSystem::initGLResources() {
-    float quadVerts[] = {
-        -0.5f, -0.5f,
-         0.5f, -0.5f,
-        -0.5f,  0.5f,
-         0.5f,  0.5f
-    };
-
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
-
-    glGenBuffers(1, &quadVBO);
-    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVerts), quadVerts, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
-
-    glGenBuffers(1, &vboInstance);
-    glBindBuffer(GL_ARRAY_BUFFER, vboInstance);
-
-    glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * maxParticles, NULL, GL_STREAM_DRAW);
-
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, pos));
-    glVertexAttribDivisor(1, 1);
-
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, intensity));
-    glVertexAttribDivisor(2, 1);
+void ParticleData::resize(size_t count) {
+    for (auto* stream : { &positionX, &positionY, &positionZ, &directionX, &directionY, &directionZ,
+                          &velocity, &life, &intensity, &scale }) {
+        stream->resize(count);
+    }
+}
 
-    glEnableVertexAttribArray(3);
-    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, scale));
-    glVertexAttribDivisor(3, 1);
+void ParticleData::push(const glm::vec3& p, const glm::vec3& d, float vel, float l, float intens, float s) {
+    positionX.push_back(p.x);
+    positionY.push_back(p.y);
+    positionZ.push_back(p.z);
+    directionX.push_back(d.x);
+    directionY.push_back(d.y);
+    directionZ.push_back(d.z);
+    velocity.push_back(vel);
+    life.push_back(l);
+    intensity.push_back(intens);
+    scale.push_back(s);
+}
 
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    glBindVertexArray(0);
+void ParticleData::moveRange(size_t from, size_t to, size_t count) {
+    for (auto* stream : { &positionX, &positionY, &positionZ, &directionX, &directionY, &directionZ,
+                          &velocity, &life, &intensity, &scale }) {
+        std::copy(stream->begin() + from, stream->begin() + from + count, stream->begin() + to);
+    }
 }
 
+void ParticleData::set(size_t i, const glm::vec3& p, const glm::vec3& d, float vel, float l, float intens, float s) {
+    setPosition(i, p);
+    setDirection(i, d);
+    velocity[i] = vel;
+    life[i] = l;
+    intensity[i] = intens;
+    scale[i] = s;
+}
 
-std::tuple<float, float, float, float, int> ParticleSystem::computeParams(float powerMW) const {
-    float t = glm::clamp(powerMW / 10000.0f, 0.0f, 1.0f);
-    float minLife = 1.0f + t * 2.0f;
-    float maxLife = 2.0f + t * 5.0f;
-    float minSize = 0.1f + t;
-    float maxSize = 0.45f + t;
-    float count = glm::clamp(static_cast<int>(powerMW * 2.5f), 1, static_cast<int>(maxParticles));
+void ParticleData::move(size_t from, size_t to) {
+    positionX[to] = positionX[from];
+    positionY[to] = positionY[from];
+    positionZ[to] = positionZ[from];
+    directionX[to] = directionX[from];
+    directionY[to] = directionY[from];
+    directionZ[to] = directionZ[from];
+    velocity[to] = velocity[from];
+    life[to] = life[from];
+    intensity[to] = intensity[from];
+    scale[to] = scale[from];
+}
 
-    return std::make_tuple(minLife, maxLife, minSize, maxSize, count);
+// Storage for every particle the system can hold is reserved here, so
+// neither emission nor the update ever reallocates.
+ParticleSystem::ParticleSystem(size_t maxParticles) : maxParticles(maxParticles) {
+    particles.reserve(maxParticles);
+    windTargets.reserve(maxParticles);
+    chunkSurvivors.reserve((maxParticles + updateChunkSize - 1) / updateChunkSize);
 }
 
 void ParticleSystem::emit(const glm::vec3 &sourcePos, int powerMW) {
-    auto [minLife, maxLife, minSize, maxSize, count] = computeParams(powerMW);
-
-    for (int i = 0; i < count; ++i) {
-        Particle p;
-
-        glm::vec3 posOffset = glm::vec3(
-            glm::linearRand(-0.5f, 0.5f),
-            glm::linearRand(-0.3f, 0.3f),
-            glm::linearRand(-0.5f, 0.5f)
-        );
-
-        glm::vec3 randomWindDirection = glm::vec3(
-            glm::linearRand(-1.0f, 1.0f),
-            0.0f,
-            glm::linearRand(-1.0f, 1.0f)
-        );
-        glm::vec randomJitter = glm::vec3(
-            glm::linearRand(-0.3f, 0.3f),
-            glm::linearRand(-0.1f, 0.1f),
-            glm::linearRand(-0.3f, 0.3f)
-        );
-        p.position = sourcePos + posOffset;
-        p.direction = glm::normalize(randomWindDirection + randomJitter);
-        p.velocity = glm::linearRand(0.1f, 0.3f);
-        p.life = glm::linearRand(minLife, maxLife);
-        p.intensity = 50.0f;
-        p.scale = glm::linearRand(minSize, maxSize);
-
-        particles.push_back(p);
-
-        if (particles.size() >= maxParticles) break;
-    }
+    EmissionParams params = ParticleEmission::computeParams(powerMW, maxParticles);
+    emit({ sourcePos, params, emissionSequence.seed, emissionSequence.next(), 0, static_cast<size_t>(params.count) });
 }
 
-void ParticleSystem::update(float deltaTime, WindGrid& windGrid) {    
-    for (auto it = particles.begin(); it != particles.end(); ) {
-        adjustToWind(static_cast<Particle&>(*it), windGrid);
+// Every particle is drawn from its own random stream, so the emission is split
+// across threads like the update and still produces the same particles.
+size_t ParticleSystem::emit(const EmissionBatch &batch) {
+    const size_t count = std::min(batch.count, getAvailable());
+    const size_t first = particles.size();
 
-        it->position += (it->velocity * it->direction) * deltaTime;
-        it->life -= deltaTime;
-        it->intensity = it->life;
+    particles.resize(first + count);
 
-        if (it->life <= 0.0f) {
-            it = particles.erase(it);
-        }
-        else {
-            ++it;
+    forEachChunk((count + updateChunkSize - 1) / updateChunkSize, [&](size_t chunk) {
+        size_t begin = chunk * updateChunkSize;
+        size_t end = std::min(begin + updateChunkSize, count);
+
+        for (size_t i = begin; i < end; ++i) {
+            EmittedParticle p = ParticleEmission::sample(batch.sourcePos, batch.params, batch.seed, batch.emission,
+                                                         batch.firstIndex + i);
+            particles.set(first + i, p.position, p.direction, p.velocity, p.life, p.intensity, p.scale);
         }
-    }
+    });
+
+    return count;
 }
 
-void ParticleSystem::adjustToWind(Particle& particle, WindGrid& windGrid) {
-    std::vector<WindVector> windVectors = windGrid.getWindVectorsAroundPoint(particle.position);
+// Splits the particles into fixed-size chunks. Each chunk samples the wind,
+// integrates with the selected kernel and compacts its own survivors, possibly
+// on different threads; the surviving runs are then moved together in chunk
+// order. Chunk boundaries do not depend on the thread count, so the result is
+// identical however many threads take part, and retiring particles stays O(n)
+// regardless of how many die at once.
+void ParticleSystem::update(float deltaTime, const WindGrid& windGrid) {
+    const size_t count = particles.size();
+    const size_t chunkCount = (count + updateChunkSize - 1) / updateChunkSize;
+    windTargets.resize(count);
+    chunkSurvivors.assign(chunkCount, 0);
+
+    ParticleStreams streams = getStreams();
+    auto updateChunk = [&](size_t chunk) {
+        size_t begin = chunk * updateChunkSize;
+        size_t end = std::min(begin + updateChunkSize, count);
+
+        for (size_t i = begin; i < end; ++i) {
+            sampleWind(i, windGrid);
+        }
 
-    if (windVectors.empty())
-        return;
+        ParticleKernels::integrate(kernel, streams, begin, end, deltaTime);
 
-    glm::vec3 blendedDir(0.0f);
-    float totalWeight = 0.0f;
-    float accumulatedVelocity = 0.0f;
+        size_t alive = begin;
+        for (size_t i = begin; i < end; ++i) {
+            if (particles.life[i] > 0.0f) {
+                if (alive != i)
+                    particles.move(i, alive);
+                ++alive;
+            }
+        }
+        chunkSurvivors[chunk] = alive - begin;
+    };
 
-    for (const auto& windVector : windVectors) {
-        float influence = calculateWindInfluence(particle, windVector);
-        if (influence < 0.01f)
-            continue;
+    forEachChunk(chunkCount, updateChunk);
 
-        glm::vec3 windDir3D = glm::normalize(glm::vec3(windVector.direction.x, 0.0f, windVector.direction.y));
-        blendedDir += windDir3D * influence;
-        accumulatedVelocity += windVector.velocity * influence;
-        totalWeight += influence;     
+    size_t alive = 0;
+    for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+        size_t begin = chunk * updateChunkSize;
+        if (alive != begin)
+            particles.moveRange(begin, alive, chunkSurvivors[chunk]);
+        alive += chunkSurvivors[chunk];
     }
 
-    if (totalWeight < 0.01f)
-        return;
-
-    glm::vec3 newDirection = glm::normalize(blendedDir / totalWeight);
-    float newVelocity = (accumulatedVelocity / totalWeight) * windVelocityScale;
+    particles.resize(alive);
+}
 
-    particle.direction = glm::normalize(glm::mix(particle.direction, newDirection, 0.1f));
-    particle.velocity = glm::mix(particle.velocity, newVelocity, 0.1f);
+void ParticleSystem::forEachChunk(size_t chunkCount, const std::function<void(size_t)>& task) {
+    if (threadPool) {
+        threadPool->parallelFor(chunkCount, task);
+    }
+    else {
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk)
+            task(chunk);
+    }
 }
 
-float ParticleSystem::calculateWindInfluence(Particle& particle, const WindVector& windVector) {
-    glm::vec2 particlePos = glm::vec2(particle.position.x, particle.position.z);
-    glm::vec2 windPos = glm::vec2(windVector.position.x, windVector.position.z);
-    float distance = glm::distance(particlePos, windPos);
-    if (distance < 0.001f) 
-        distance = 0.001f;
-        
-    float influence = (windVector.velocity) / (pow(distance, 2) + 1.0f);
+void ParticleSystem::sampleWind(size_t index, const WindGrid& windGrid) {
+    glm::vec2 position = glm::vec2(particles.positionX[index], particles.positionZ[index]);
+    glm::vec3 newDirection;
+    float windVelocity;
+
+    bool hasWind = windField && windField->isBaked()
+        ? windField->sample(position, newDirection, windVelocity)
+        : windGrid.blendAtPoint(position, newDirection, windVelocity);
 
-    return influence;
+    windTargets.directionX[index] = hasWind ? newDirection.x : 0.0f;
+    windTargets.directionZ[index] = hasWind ? newDirection.z : 0.0f;
+    windTargets.velocity[index] = hasWind ? windVelocity * windVelocityScale : 0.0f;
+    windTargets.weight[index] = hasWind ? 1.0f : 0.0f;
 }
 
-void ParticleSystem::updateGPUBuffer() {
-    instances.clear();
-    instances.reserve(particles.size());
-    for (const auto &p : particles) {
-        instances.push_back({ p.position, p.intensity, p.scale });
-    }
-    glBindBuffer(GL_ARRAY_BUFFER, vboInstance);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(InstanceData), instances.data());
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
+ParticleStreams ParticleSystem::getStreams() {
+    return {
+        particles.positionX.data(), particles.positionY.data(), particles.positionZ.data(),
+        particles.directionX.data(), particles.directionY.data(), particles.directionZ.data(),
+        particles.velocity.data(),
+        particles.life.data(),
+        particles.intensity.data(),
+        windTargets.directionX.data(), windTargets.directionZ.data(),
+        windTargets.velocity.data(),
+        windTargets.weight.data()
+    };
+}
+
+void WindTargets::reserve(size_t count) {
+    directionX.reserve(count);
+    directionZ.reserve(count);
+    velocity.reserve(count);
+    weight.reserve(count);
 }
 
-void ParticleSystem::draw() {
-    glDepthMask(GL_FALSE);
-    updateGPUBuffer();
-    glBindVertexArray(vao);
-    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)instances.size());
-    glBindVertexArray(0);
-    glDepthMask(GL_TRUE);
+void WindTargets::resize(size_t count) {
+    directionX.resize(count);
+    directionZ.resize(count);
+    velocity.resize(count);
+    weight.resize(count);
 }
@@ -1,52 +1,100 @@
 #pragma once
 
 #include <glm/glm.hpp>
-#include <glm/gtc/random.hpp>
-#include <glad/glad.h>
-#include <GLFW/glfw3.h>
 
-#include <iostream>
+#include <cstdint>
+#include <functional>
 #include <vector>
 
+#include "emission_scheduler.hpp"
+#include "particle_emission.hpp"
+#include "particle_kernels.hpp"
+#include "thread_pool.hpp"
+#include "wind_field.hpp"
 #include "wind_grid.hpp"
 
-struct Particle {
-    glm::vec3 position;
-    glm::vec3 direction;
-    float velocity;
-    float life;
-    float intensity;
-    float scale;
-};
+// Particles are kept as a structure of arrays: every attribute lives in its own
+// contiguous float stream, so the update loop walks memory linearly and dead
+// particles can be compacted away in a single pass.
+struct ParticleData {
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> directionX, directionY, directionZ;
+    std::vector<float> velocity;
+    std::vector<float> life;
+    std::vector<float> intensity;
+    std::vector<float> scale;
+
+    size_t size() const { return life.size(); }
+    bool empty() const { return life.empty(); }
+
+    glm::vec3 getPosition(size_t i) const { return { positionX[i], positionY[i], positionZ[i] }; }
+    glm::vec3 getDirection(size_t i) const { return { directionX[i], directionY[i], directionZ[i] }; }
 
-struct InstanceData {
-    glm::vec3 pos;
-    float intensity;
-    float scale;
+    void setPosition(size_t i, const glm::vec3& p) { positionX[i] = p.x; positionY[i] = p.y; positionZ[i] = p.z; }
+    void setDirection(size_t i, const glm::vec3& d) { directionX[i] = d.x; directionY[i] = d.y; directionZ[i] = d.z; }
+
+    void reserve(size_t count);
+    void resize(size_t count);
+    void push(const glm::vec3& position, const glm::vec3& direction, float velocity, float life, float intensity, float scale);
+    void set(size_t i, const glm::vec3& position, const glm::vec3& direction, float velocity, float life, float intensity, float scale);
+    void move(size_t from, size_t to);
+    // Moves count particles starting at from down to to; requires to <= from.
+    void moveRange(size_t from, size_t to, size_t count);
 };
 
-const float windVelocityScale = 0.10f;
+// Wind each particle is blended towards during integration, sampled per frame.
+struct WindTargets {
+    std::vector<float> directionX, directionZ;
+    std::vector<float> velocity;
+    std::vector<float> weight;
+
+    void reserve(size_t count);
+    void resize(size_t count);
+};
 
+// CPU particle simulation. It does not touch OpenGL, so it links into the
+// headless tools as well; CpuParticleSystem draws it in the viewer.
 class ParticleSystem {
 public:
-    void initialize();
+    explicit ParticleSystem(size_t maxParticles = 50000);
+
+    // Releases a whole explosion at once
     void emit(const glm::vec3& sourcePos, int powerMW);
-    void update(float deltaTime, WindGrid& windGrid);
-    void adjustToWind(Particle& particle, WindGrid& windGrid);
-    float calculateWindInfluence(Particle& particle, const WindVector& windVector);
-    void draw();
+    // Appends the batch's particles, as many as fit; returns how many did
+    size_t emit(const EmissionBatch& batch);
+    void update(float deltaTime, const WindGrid& windGrid);
+    void setSeed(uint64_t seed) { emissionSequence = { seed, 0 }; }
 
-private:
-    std::vector<Particle> particles;
-    std::vector<InstanceData> instances;
+    // Samples wind from a baked field instead of blending the grid per particle.
+    // Pass nullptr to go back to the exact per-particle blend.
+    void setWindField(const WindField* field) { windField = field; }
+
+    // Integration kernel, defaults to the widest one the CPU supports. The
+    // scalar kernel is kept as the reference implementation.
+    void setKernel(ParticleKernels::Kernel k) { kernel = k; }
+    ParticleKernels::Kernel getKernel() const { return kernel; }
 
-    unsigned int vao = 0;
-    unsigned int vboInstance = 0;
-    unsigned int quadVBO = 0;
-    const size_t maxParticles = 50000;
+    // Spreads emit() and update() across the pool's threads; without one they
+    // run serially.
+    void setThreadPool(ThreadPool* pool) { threadPool = pool; }
 
-    void initGLResources();
-    void updateGPUBuffer();
-    std::tuple<float, float, float, float, int> computeParams(float powerMW) const;
+    size_t size() const { return particles.size(); }
+    size_t getMaxParticles() const { return maxParticles; }
+    size_t getAvailable() const { return maxParticles - particles.size(); }
+    const ParticleData& getParticles() const { return particles; }
 
-};
\ No newline at end of file
+private:
+    ParticleData particles;
+    WindTargets windTargets;
+    const WindField* windField = nullptr;
+    ParticleKernels::Kernel kernel = ParticleKernels::detectBestKernel();
+    ThreadPool* threadPool = nullptr;
+    std::vector<size_t> chunkSurvivors;
+    static constexpr size_t updateChunkSize = 16384;
+    EmissionSequence emissionSequence;
+    const size_t maxParticles;
+
+    void forEachChunk(size_t chunkCount, const std::function<void(size_t)>& task);
+    void sampleWind(size_t index, const WindGrid& windGrid);
+    ParticleStreams getStreams();
+};
@@ -0,0 +1,96 @@
+#include "plant_instances.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+PlantInstances::~PlantInstances() {
+    if (instanceBuffer)
+        glDeleteBuffers(1, &instanceBuffer);
+}
+
+void PlantInstances::initialize(Model& model) {
+    if (!instanceBuffer)
+        glGenBuffers(1, &instanceBuffer);
+    model.setInstanceBuffer(instanceBuffer);
+    boundingCenter = model.getBoundingCenter();
+    boundingRadius = model.getBoundingRadius();
+    lodCount = model.getLodCount();
+    built = false;
+}
+
+void PlantInstances::update(const std::vector<PowerPlant>& plants, int selected, const glm::vec3& cameraPosition, float screenScale) {
+    bool unchanged = built && selected == builtSelection && plants.size() == builtPositions.size();
+    for (size_t i = 0; unchanged && i < plants.size(); ++i)
+        unchanged = plants[i].position == builtPositions[i];
+
+    if (!unchanged) {
+        instances.clear();
+        builtPositions.clear();
+        for (size_t i = 0; i < plants.size(); ++i) {
+            glm::mat4 model = glm::translate(glm::mat4(1.0f), plants[i].position);
+            model = glm::scale(model, glm::vec3(modelScale));
+
+            // Red over the selected plant's texture
+            glm::vec4 highlight = static_cast<int>(i) == selected ? glm::vec4(1.0f, 0.0f, 0.0f, 1.0f) : glm::vec4(0.0f);
+            instances.push_back({ model, highlight });
+            builtPositions.push_back(plants[i].position);
+        }
+        builtSelection = selected;
+        built = true;
+        instanceLods.assign(instances.size(), 0);
+        uploadNeeded = true;
+    }
+
+    const float radius = boundingRadius * modelScale;
+    for (size_t i = 0; i < instances.size(); ++i) {
+        glm::vec3 center = builtPositions[i] + boundingCenter * modelScale;
+        float distance = std::max(glm::length(center - cameraPosition), radius);
+        float pixels = 2.0f * radius * screenScale / distance;
+
+        unsigned char lod = 0;
+        for (float threshold = fullDetailPixels; pixels < threshold && lod + 1u < lodCount; threshold *= 0.5f)
+            ++lod;
+        if (lod != instanceLods[i]) {
+            instanceLods[i] = lod;
+            uploadNeeded = true;
+        }
+    }
+    if (!uploadNeeded)
+        return;
+
+    // Group by level so each level is one contiguous range
+    lodCounts.assign(lodCount, 0);
+    for (unsigned char lod : instanceLods)
+        ++lodCounts[lod];
+    lodFirsts.assign(lodCount, 0);
+    for (size_t lod = 1; lod < lodCount; ++lod)
+        lodFirsts[lod] = lodFirsts[lod - 1] + lodCounts[lod - 1];
+
+    uploaded.resize(instances.size());
+    std::vector<GLsizei> next = lodFirsts;
+    for (size_t i = 0; i < instances.size(); ++i)
+        uploaded[next[instanceLods[i]]++] = instances[i];
+    uploadNeeded = false;
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, uploaded.size() * sizeof(MeshInstance), uploaded.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PlantInstances::draw(Shader& shader, Model& model) const {
+    for (size_t lod = 0; lod < lodCounts.size(); ++lod) {
+        if (lodCounts[lod] == 0)
+            continue;
+        model.setInstanceBuffer(instanceBuffer, lodFirsts[lod]);
+        model.DrawInstanced(shader, lodCounts[lod], lod);
+    }
+}
+
+size_t PlantInstances::getTriangleCount(const Model& model) const {
+    size_t triangles = 0;
+    for (size_t lod = 0; lod < lodCounts.size(); ++lod)
+        triangles += lodCounts[lod] * model.getTriangleCount(lod);
+    return triangles;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "mesh.hpp"
+#include "model.hpp"
+#include "power_plants.hpp"
+
+// Draws a cooling tower at every power plant with one instanced draw per mesh
+// and level of detail of the model. Each tower takes the level that matches
+// the size of its bounding sphere on screen. The instance buffer holds each
+// tower's model matrix and highlight colour grouped by level, and is
+// uploaded only when the plants, the selection or a tower's level change.
+class PlantInstances {
+public:
+    PlantInstances() = default;
+    ~PlantInstances();
+
+    PlantInstances(const PlantInstances&) = delete;
+    PlantInstances& operator=(const PlantInstances&) = delete;
+
+    // Points the model's meshes at the instance buffer and reads its bounds
+    void initialize(Model& model);
+    // selected is an index into plants, -1 for none. screenScale is the
+    // viewport height over 2 tan(fovY / 2), the pixels one unit covers at
+    // distance one
+    void update(const std::vector<PowerPlant>& plants, int selected, const glm::vec3& cameraPosition, float screenScale);
+    // Expects shader in use
+    void draw(Shader& shader, Model& model) const;
+
+    size_t size() const { return instances.size(); }
+    // Towers drawn at each level in the last update
+    const std::vector<GLsizei>& getLodInstanceCounts() const { return lodCounts; }
+    size_t getTriangleCount(const Model& model) const;
+
+private:
+    static constexpr float modelScale = 0.003f;
+    // Screen diameter in pixels below which a tower drops to the next level;
+    // halves per level as each has half the edge length
+    static constexpr float fullDetailPixels = 400.0f;
+
+    GLuint instanceBuffer = 0;
+    std::vector<MeshInstance> instances;
+
+    // Model bounds and levels, from initialize
+    glm::vec3 boundingCenter = glm::vec3(0.0f);
+    float boundingRadius = 0.0f;
+    size_t lodCount = 1;
+
+    // Level of each instance and the buffer layout built from them
+    std::vector<unsigned char> instanceLods;
+    std::vector<GLsizei> lodFirsts, lodCounts;
+    std::vector<MeshInstance> uploaded;
+    bool uploadNeeded = true;
+
+    // What the buffer was last built from
+    std::vector<glm::vec3> builtPositions;
+    int builtSelection = -1;
+    bool built = false;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+struct PowerPlant {
+    std::string name;
+    glm::vec3 position;
+    float powerMW;
+
+    PowerPlant(const std::string& name, const glm::vec3& pos, float mw)
+        : name(name), position(pos), powerMW(mw) {}
+
+    // Particles leave the plant from the top of the cooling tower
+    glm::vec3 getEmissionPoint() const { return position + glm::vec3(0.0f, 2.5f, 0.0f); }
+};
+
+namespace PowerPlants {
+    inline std::vector<PowerPlant> getDefaultPlants() {
+        return {
+            { "Zaporozhye", {22.0f, 0.0f, 4.0f},     6000.0f },
+            { "Forsmark",   {3.0f, 0.0f, -10.0f},    3000.0f },
+            { "Chooz",      {-10.0f, 0.0f, 1.5f},    3120.0f },
+            { "Mochovce",   {6.0f, 0.0f, 4.0f},      1950.0f },
+            { "Vandellos",  {-14.0f, 0.0f, 12.0f},   1060.0f }
+        };
+    }
+}
@@ -14,59 +14,118 @@
 #include <stb_image/stb_image.h>
 
 #include <array>
+#include <cmath>
 #include <iostream>
 #include <optional>
 #include <vector>
 #include <chrono>
+#include <fstream>
+#include <functional>
+#include <memory>
 #include <thread>
 
+#include "asset_loader.hpp"
 #include "box.hpp"
 #include "callbacks.hpp"
 #include "camera.hpp"
+#include "camera_uniforms.hpp"
 #include "object.hpp"
 #include "renderer.hpp"
 #include "shader.hpp"
 #include "texture.hpp"
 #include "world_constraints.hpp"
 #include "model.hpp"
-#include "particle_system.hpp"
+#include "cpu_particle_system.hpp"
+#include "gpu_particle_system.hpp"
+#include "puff_particle_system.hpp"
+#include "eulerian_grid_system.hpp"
+#include "thread_pool.hpp"
 #include "contamination.hpp"
+#include "contamination_readback.hpp"
+#include "contamination_stats.hpp"
+#include "exposure_map.hpp"
+#include "wind_field.hpp"
 #include "wind_grid.hpp"
+#include "wind_vector_instances.hpp"
 #include "gui.hpp"
+#include "power_plants.hpp"
+#include "plant_instances.hpp"
+#include "nuclides.hpp"
+
+// Rasters the exposure totals come from. Empty paths fall back to the files
+// under textures/, which are not shipped and skipped when absent; paths given
+// here are loaded as they are and report failures.
+struct ExposureRasters {
+    std::string regions;
+    std::string regionNames;
+    std::string population;
+    float populationScale = 1.0f;
+};
 
 class Program {
 public:
-    struct PowerPlant {
-        glm::vec3 position;
-        float powerMW;
-
-        PowerPlant(const glm::vec3& pos, float mw)
-            : position(pos), powerMW(mw) {}
-    };
-
+    enum ReleaseShape { InstantRelease, ConstantRelease, DecayingRelease };
+    enum ParticleEngine { CpuParticles, GpuParticles, GaussianPuffs, EulerianGrid };
+
+    // First member so its clock starts with the program
+    AssetLoader assetLoader;
+    // Frame time the context thread spends on asset uploads while loading
+    static constexpr double assetUploadBudgetMs = 8.0;
+
+    // Starts GLFW and terminates it, taking the window and its context along,
+    // only after every member below has deleted its GL objects
+    struct GlfwSession {
+        GlfwSession() { glfwInit(); }
+        ~GlfwSession() { glfwTerminate(); }
+    } glfwSession;
     GLFWwindow* window;
-    std::optional<Shader> boxShader, planeShader, axisShader, modelShader, particleShader, windVectorShader, contaminationShader;
+    // Empty until their asset has loaded; the renderers skip what is missing
+    std::optional<Shader> boxShader, planeShader, axisShader, modelShader, particleShader, windVectorShader, contaminationShader, contaminationDecayShader;
+    // Locations of the uniforms the renderers set every frame, looked up once
+    // their shader has linked
+    struct FrameUniforms {
+        GLint boxModel = -1;
+        GLint planeModel = -1;
+        GLint axisModel = -1;
+        Contamination::SamplingUniforms planeSampling;
+        GLint contaminationView = -1;
+        GLint contaminationProjection = -1;
+        GLint contaminationDeltaTime = -1;
+        GLint decayFactor = -1;
+        GLint windVectorTime = -1;
+        GLint windVectorOutline = -1;
+    } frameUniforms;
     std::optional<Texture> texture1, texture2, texture3, psTexture;
     std::optional<Object> box, plane, axis, vectorArrow;
     std::optional<Model> powerPlantModel;
     std::array<glm::vec3, 10> cubePositions;
     std::vector<PowerPlant> nuclearPowerPlants;
-    std::vector<std::string> plantNames = {
-    "Zaporozhye",
-    "Forsmark",
-    "Chooz",
-    "Mochovce",
-    "Vandellos"
-    };
+    PlantInstances plantInstances;
+    std::vector<Nuclide> nuclides = Nuclides::getDefaultNuclides();
     std::optional<int> selectedPlantIndex;
 
     Camera camera;
+    CameraUniformBuffer cameraUniforms;
     WindGrid windGrid;
+    WindVectorInstances windVectorInstances;
+    WindField windField;
     Contamination contaminationMask;
-    ParticleSystem particleSystem;
+    ContaminationStats contaminationStats;
+    ContaminationReadback contaminationReadback;
+    std::vector<float> statsCells;
+    ExposureMap exposureMap;
+    ThreadPool threadPool;
+    CpuParticleSystem particleSystem;
+    GpuParticleSystem gpuParticleSystem;
+    PuffParticleSystem puffParticleSystem;
+    EulerianGridSystem eulerianGridSystem;
 
     const unsigned int SCR_WIDTH = 1200;
     const unsigned int SCR_HEIGHT = 800;
+    // Dense contamination texture the GPU particles splat into; CPU grids are
+    // shown sparsely at their own resolution
+    const unsigned int CONTAMINATION_WIDTH = 1200;
+    const unsigned int CONTAMINATION_HEIGHT = 800;
     float lastX = SCR_WIDTH / 2.0f;
     float lastY = SCR_HEIGHT / 2.0f;
     bool firstMouse = true;
@@ -74,9 +133,18 @@ public:
     float lastFrame = 0.0f;
     bool renderWindVectors = true;
     bool renderAxis = false;
-
-    Program(const char* programName) {
-        glfwInit();
+    int particleEngine = CpuParticles;
+    int releaseShape = InstantRelease;
+    float releaseDuration = 60.0f;
+    int decayNuclide = -1; // index into nuclides, -1 for no decay
+    float decayDaysPerSecond = 1.0f;
+    int statsInterval = 10; // frames between contamination summaries
+    int framesSinceStats = 0;
+
+    // loaderThreads 0 loads every asset before the constructor returns
+    Program(const char* programName, unsigned int loaderThreads = AssetLoader::defaultWorkerCount(),
+            const ExposureRasters& exposureRasters = ExposureRasters())
+        : assetLoader(loaderThreads) {
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
         glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
@@ -106,40 +174,62 @@ public:
         glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        assetLoader.mark("window created");
 
-        initShaders();
-        contaminationMask.initialize(SCR_WIDTH, SCR_HEIGHT);
+        cameraUniforms.initialize();
+        contaminationMask.initialize(CONTAMINATION_WIDTH, CONTAMINATION_HEIGHT);
         contaminationMask.clear();
+        initShaders();
         initTextures();
         initObjects();
 
         particleSystem.initialize();
+        gpuParticleSystem.initialize();
+        puffParticleSystem.initialize();
         windGrid.initialize();
+        windField.bake(windGrid);
+        windVectorInstances.initialize(getVectorArrow());
+        windVectorInstances.upload(windGrid.getWindVectors());
+        particleSystem.getSimulation().setWindField(&windField);
+        particleSystem.getSimulation().setThreadPool(&threadPool);
+        particleSystem.getSimulationThread().getDeposition().setThreadPool(&threadPool);
+        particleSystem.start(windGrid);
+        gpuParticleSystem.setWindField(&windField);
+        puffParticleSystem.getSimulation().setWindField(&windField);
+        eulerianGridSystem.getSimulation().setWindField(&windField);
+        eulerianGridSystem.getSimulation().setThreadPool(&threadPool);
+        loadExposure(exposureRasters);
 
         selectedPlantIndex.emplace(-1);
         camera = Camera(glm::vec3(0.0f, 10.0f, 0.0f), -90.0f, -45.0f);
+        assetLoader.mark("constructor done");
     }
 
+    // GLFW is terminated by glfwSession, once the other members are gone
     ~Program() {
         Gui::shutdown();
-        glfwTerminate();
     }
 
     void renderLoop() {
         std::cout << "Render loop started\n";
+        bool firstFrame = true;
 
         while (!glfwWindowShouldClose(window)) {
+            assetLoader.pump(assetUploadBudgetMs);
+
             float currentFrame = static_cast<float>(glfwGetTime());
             deltaTime = currentFrame - lastFrame;
             lastFrame = currentFrame;
             glfwSwapInterval(1); // vsync
 
             processInput(window);
+            cameraUniforms.update(camera, Renderer::buildProjectionMatrix(this));
 
             glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            particleSystem.update(deltaTime, windGrid);
+            getParticles().update(deltaTime, windGrid);
+            decayContamination(deltaTime);
 
             Renderer::renderBoxes(this);
             Renderer::renderPlane(this);
@@ -153,12 +243,17 @@ public:
                 Renderer::renderWindVectors(this);
 
             Renderer::renderParticles(this);
+            collectContaminationStats();
 
             Gui::beginFrame();
             Gui::render(this);
             Gui::endFrame();
 
             glfwSwapBuffers(window);
+            if (firstFrame) {
+                assetLoader.mark("first frame");
+                firstFrame = false;
+            }
             glfwPollEvents();
             limitFPS(60);
         }
@@ -172,6 +267,7 @@ public:
     Shader& getParticleShader()  { return getShader(particleShader, "Particle"); }
     Shader& getWindVectorShader() { return getShader(windVectorShader, "Wind Vector"); }
     Shader& getContaminationShader(){ return getShader(contaminationShader, "Contamination"); }
+    Shader& getContaminationDecayShader(){ return getShader(contaminationDecayShader, "Contamination Decay"); }
 
     // === Textures ===
     Texture& getTexture1() { return getTexture(texture1, "Texture1"); }
@@ -190,9 +286,79 @@ public:
     }
 
     // === Misc ===
+    ParticleBackend& getParticles() {
+        if (particleEngine == GpuParticles) return gpuParticleSystem;
+        if (particleEngine == GaussianPuffs) return puffParticleSystem;
+        if (particleEngine == EulerianGrid) return eulerianGridSystem;
+        return particleSystem;
+    }
+    // The plant's whole inventory, spread as chosen in the GUI
+    ReleaseProfile getReleaseProfile(float powerMW) const {
+        uint64_t total = ParticleEmission::getReleaseCount(powerMW);
+        if (releaseShape == ConstantRelease)
+            return ReleaseProfile::constant(total, releaseDuration);
+        if (releaseShape == DecayingRelease)
+            return ReleaseProfile::decaying(total, releaseDuration / 4.0f, releaseDuration);
+        return ReleaseProfile::instant(total);
+    }
+    void clearContamination() {
+        contaminationMask.clear();
+        if (DepositionGrid* deposition = getParticles().getDeposition())
+            deposition->clear();
+    }
+    void loadExposure(const ExposureRasters& rasters) {
+        auto pick = [](const std::string& given, const char* fallback) {
+            if (!given.empty())
+                return given;
+            std::string path = FileSystem::getPath(fallback);
+            return std::ifstream(path).good() ? path : std::string();
+        };
+
+        const std::string regions = pick(rasters.regions, "textures/regions.png");
+        const std::string population = pick(rasters.population, "textures/population.png");
+        if (!regions.empty())
+            exposureMap.loadRegions(regions, pick(rasters.regionNames, "textures/regions.txt"));
+        if (!population.empty())
+            exposureMap.loadPopulation(population, rasters.populationScale);
+    }
+    // Decays the contamination of the selected nuclide by deltaTime seconds of
+    // the decay clock, on the CPU grid if the backend keeps one
+    void decayContamination(float deltaTime) {
+        if (decayNuclide < 0 || decayNuclide >= static_cast<int>(nuclides.size()))
+            return;
+
+        // In double: for the long half-lives a frame's factor is within a
+        // millionth of 1, too close for a float to keep the rate
+        double factor = std::exp2(-static_cast<double>(deltaTime) * decayDaysPerSecond / nuclides[decayNuclide].halfLifeDays);
+        if (DepositionGrid* deposition = getParticles().getDeposition())
+            deposition->decay(factor);
+        else if (contaminationDecayShader)
+            contaminationMask.decay(*contaminationDecayShader, frameUniforms.decayFactor, factor);
+    }
+    // Hands the contamination to the statistics worker every statsInterval
+    // frames: a CPU grid is copied directly, the dense texture is read back
+    // asynchronously and summarised once its copy has landed. Exposure is
+    // totalled at the same pace, and only with rasters to total it over.
+    void collectContaminationStats() {
+        if (++framesSinceStats >= statsInterval) {
+            framesSinceStats = 0;
+            if (DepositionGrid* deposition = getParticles().getDeposition()) {
+                if (exposureMap.hasRegions() || exposureMap.hasPopulation())
+                    exposureMap.update(*deposition, &threadPool);
+                statsCells.clear();
+                deposition->copyCells(statsCells);
+                glm::vec2 cellSize = deposition->getCellSize();
+                contaminationStats.submit(std::move(statsCells), cellSize.x * cellSize.y, lastFrame);
+            } else {
+                contaminationReadback.request(contaminationMask, lastFrame);
+            }
+        }
+        contaminationReadback.poll(contaminationStats);
+    }
     Camera& getCamera() { return camera; }
     WindGrid& getWindGrid() { return windGrid; }
     float getAspectRatio() const { return float(SCR_WIDTH) / float(SCR_HEIGHT); }
+    float getScreenHeight() const { return float(SCR_HEIGHT); }
     float getFov() const { return camera.Zoom; }
     int getSelectedPlantIndex() const {
         if (!selectedPlantIndex) throw std::runtime_error("Selected plant index not initialized");
@@ -200,51 +366,83 @@ public:
     }
 
 private:
+    // Shader sources, textures and the plant model are read and decoded on
+    // the asset loader's workers; compiling and uploading happen in pump()
     void initShaders() {
-        boxShader.emplace("shaders/box.vs", "shaders/box.fs");
-        planeShader.emplace("shaders/plane.vs", "shaders/plane.fs");
-        axisShader.emplace("shaders/axis.vs", "shaders/axis.fs");
-        modelShader.emplace("shaders/model.vs", "shaders/model.fs");
-        particleShader.emplace("shaders/particle.vs", "shaders/particle.fs");
-        contaminationShader.emplace("shaders/contamination.vs", "shaders/contamination.fs");
-        windVectorShader.emplace("shaders/wind_vector.vs", "shaders/wind_vector.fs");
+        loadShader(boxShader, "shaders/box.vs", "shaders/box.fs", [this](Shader& shader) {
+            shader.setInt("texture1", 0);
+            shader.setInt("texture2", 1);
+            frameUniforms.boxModel = shader.getUniformLocation("model");
+        });
+        loadShader(planeShader, "shaders/plane.vs", "shaders/plane.fs", [this](Shader& shader) {
+            shader.setInt("Tex", 0);
+            frameUniforms.planeModel = shader.getUniformLocation("model");
+            frameUniforms.planeSampling = Contamination::SamplingUniforms::locate(shader);
+            contaminationMask.bindForSampling(shader, frameUniforms.planeSampling);
+        });
+        loadShader(axisShader, "shaders/axis.vs", "shaders/axis.fs", [this](Shader& shader) {
+            frameUniforms.axisModel = shader.getUniformLocation("model");
+        });
+        loadShader(modelShader, "shaders/model.vs", "shaders/model.fs");
+        loadShader(particleShader, "shaders/particle.vs", "shaders/particle.fs", [](Shader& shader) {
+            shader.setInt("particleTexture", 0);
+        });
+        loadShader(contaminationShader, "shaders/contamination.vs", "shaders/contamination.fs", [this](Shader& shader) {
+            frameUniforms.contaminationView = shader.getUniformLocation("view");
+            frameUniforms.contaminationProjection = shader.getUniformLocation("projection");
+            frameUniforms.contaminationDeltaTime = shader.getUniformLocation("deltaTime");
+        });
+        loadShader(contaminationDecayShader, "shaders/contamination_decay.vs", "shaders/contamination_decay.fs",
+                   [this](Shader& shader) {
+            shader.setInt("source", 0);
+            frameUniforms.decayFactor = shader.getUniformLocation("factor");
+        });
+        loadShader(windVectorShader, "shaders/wind_vector.vs", "shaders/wind_vector.fs", [this](Shader& shader) {
+            frameUniforms.windVectorTime = shader.getUniformLocation("time");
+            frameUniforms.windVectorOutline = shader.getUniformLocation("outline");
+        });
     }
 
     void initTextures() {
-        texture1.emplace("textures/container.jpg");
-        texture2.emplace("textures/awesomeface.png");
-        texture3.emplace("textures/europe_map.png");
-        psTexture.emplace("textures/dot.png");
-
-        getBoxShader().use();
-        getBoxShader().setInt("texture1", 0);
-        getBoxShader().setInt("texture2", 1);
-
-        getPlaneShader().use();
-        glActiveTexture(GL_TEXTURE0);
-        texture3->bindTexture(GL_TEXTURE0);
-        getPlaneShader().setInt("Tex", 0);
-
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, contaminationMask.getTextureID());
-        getPlaneShader().setInt("ContaminationTex", 1);
+        loadTexture(texture1, "textures/container.jpg");
+        loadTexture(texture2, "textures/awesomeface.png");
+        loadTexture(texture3, "textures/europe_map.png");
+        loadTexture(psTexture, "textures/dot.png");
+    }
 
-        getParticleShader().use();
-        getParticleShader().setInt("particleTexture", 0);
+    // onReady runs on the context thread with the new shader in use
+    void loadShader(std::optional<Shader>& slot, const char* vertexPath, const char* fragmentPath,
+                    std::function<void(Shader&)> onReady = nullptr) {
+        assetLoader.submit(vertexPath, [&slot, vertexPath, fragmentPath, onReady] {
+            auto source = std::make_shared<ShaderSource>(ShaderSource::read(vertexPath, fragmentPath));
+            return [&slot, source, onReady] {
+                slot.emplace(*source);
+                if (onReady) {
+                    slot->use();
+                    onReady(*slot);
+                    glUseProgram(0);
+                }
+            };
+        });
+    }
 
-        glUseProgram(0);
+    void loadTexture(std::optional<Texture>& slot, const char* path) {
+        assetLoader.submit(path, [&slot, path] {
+            auto image = std::make_shared<ImageData>(Texture::load(path));
+            return [&slot, image] { slot.emplace(*image); };
+        });
     }
 
     void initObjects() {
-        powerPlantModel.emplace("../models/cooling_tower.obj");
-
-        nuclearPowerPlants = {
-            { {22.0f, 0.0f, 4.0f},     6000.0f },
-            { {3.0f, 0.0f, -10.0f},    3000.0f },
-            { {-10.0f, 0.0f, 1.5f},    3120.0f },
-            { {6.0f, 0.0f, 4.0f},      1950.0f },
-            { {-14.0f, 0.0f, 12.0f},   1060.0f }
-        };
+        assetLoader.submit("../models/cooling_tower.obj", [this] {
+            auto data = std::make_shared<ModelData>(Model::read("../models/cooling_tower.obj"));
+            return [this, data] {
+                powerPlantModel.emplace(std::move(*data));
+                plantInstances.initialize(*powerPlantModel);
+            };
+        });
+
+        nuclearPowerPlants = PowerPlants::getDefaultPlants();
 
         auto attributes = std::vector<int>{ 3, 2 };
         box.emplace(vertices, sizeof(vertices), attributes);
@@ -310,7 +508,7 @@ private:
             camera.ProcessKeyboard(RIGHT, deltaTime);
 
         if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
-            contaminationMask.clear();
+            clearContamination();
         if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS)
             renderWindVectors = true;
         if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS)
@@ -0,0 +1,91 @@
+#include "puff_particle_system.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <algorithm>
+#include <limits>
+
+PuffParticleSystem::PuffParticleSystem(size_t maxPuffs) : puffs(maxPuffs) {
+    // Puffs take on any amount of material in constant time, nothing to spread
+    scheduler.setBudget(std::numeric_limits<size_t>::max());
+    instances.reserve(maxPuffs);
+}
+
+PuffParticleSystem::~PuffParticleSystem() {
+    if (!vao)
+        return;
+
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &quadVBO);
+    glDeleteBuffers(1, &vboInstance);
+}
+
+void PuffParticleSystem::initialize() {
+    float quadVerts[] = {
+        -0.5f, -0.5f,
+         0.5f, -0.5f,
+        -0.5f,  0.5f,
+         0.5f,  0.5f
+    };
+
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    glGenBuffers(1, &quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quadVerts), quadVerts, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void *)0);
+
+    glGenBuffers(1, &vboInstance);
+    glBindBuffer(GL_ARRAY_BUFFER, vboInstance);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * puffs.getMaxPuffs(), NULL, GL_STREAM_DRAW);
+
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, pos));
+    glVertexAttribDivisor(1, 1);
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, intensity));
+    glVertexAttribDivisor(2, 1);
+    glEnableVertexAttribArray(3);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void *)offsetof(InstanceData, scale));
+    glVertexAttribDivisor(3, 1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+}
+
+void PuffParticleSystem::release(const glm::vec3 &sourcePos, int powerMW, const ReleaseProfile &profile) {
+    scheduler.schedule(sourcePos, powerMW, profile, std::numeric_limits<size_t>::max());
+}
+
+void PuffParticleSystem::update(float deltaTime, const WindGrid &windGrid) {
+    for (const EmissionBatch &batch : scheduler.collectDue(deltaTime, std::numeric_limits<size_t>::max()))
+        puffs.emit(batch);
+
+    puffs.update(deltaTime, windGrid);
+    puffs.deposit(deposition, deltaTime);
+}
+
+// A few hundred instances at most, small enough to re-specify every frame.
+void PuffParticleSystem::prepareInstances() {
+    instances.clear();
+    for (const Puff &puff : puffs.getPuffs()) {
+        float sigma = puff.getFootprintSigma();
+        float coverage = puff.mass * puff.getAliveFraction() * puff.meanArea / (2.0f * glm::pi<float>() * sigma * sigma);
+        instances.push_back({ puff.position, std::min(coverage, 1.0f), 4.0f * sigma });
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vboInstance);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(InstanceData) * puffs.getMaxPuffs(), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(InstanceData) * instances.size(), instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PuffParticleSystem::draw() {
+    glDepthMask(GL_FALSE);
+    glBindVertexArray(vao);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances.size()));
+    glBindVertexArray(0);
+    glDepthMask(GL_TRUE);
+}
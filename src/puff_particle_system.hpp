@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "deposition_grid.hpp"
+#include "emission_scheduler.hpp"
+#include "particle_backend.hpp"
+#include "puff_system.hpp"
+
+// Draws a PuffSystem, one billboard per puff. The quad covers the puff's
+// footprint out to two sigma and its opacity is the share of the ground the
+// particles it stands for would cover at the centre, so a puff looks like the
+// cloud of particles it replaces.
+class PuffParticleSystem : public ParticleBackend {
+public:
+    explicit PuffParticleSystem(size_t maxPuffs = PuffSystem::defaultMaxPuffs);
+    ~PuffParticleSystem();
+
+    void initialize() override;
+    void release(const glm::vec3& sourcePos, int powerMW, const ReleaseProfile& profile) override;
+    void update(float deltaTime, const WindGrid& windGrid) override;
+    void prepareInstances() override;
+    void draw() override;
+    void setSeed(uint64_t seed) override { scheduler.setSeed(seed); }
+
+    size_t size() override { return puffs.size(); }
+    const char* getName() const override { return "Puffs"; }
+    DepositionGrid* getDeposition() override { return &deposition; }
+
+    PuffSystem& getSimulation() { return puffs; }
+
+private:
+    PuffSystem puffs;
+    EmissionScheduler scheduler;
+    DepositionGrid deposition;
+    std::vector<InstanceData> instances;
+
+    GLuint vao = 0;
+    GLuint vboInstance = 0;
+    GLuint quadVBO = 0;
+};
@@ -0,0 +1,196 @@
+#include "puff_system.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    // Same per-step blend towards the wind as the particle kernels
+    const float windBlend = 0.1f;
+
+    // Spread of the particles at release, uniform in +-0.5 around the source
+    const float initialSigma = 0.29f;
+    // Widening over time and over distance travelled, fitted by eye to the
+    // particle plume under the default wind grid
+    const float growthPerSecond = 0.1f;
+    const float growthPerDistance = 0.1f;
+
+    // Puffs wider than this no longer see a single wind and are split
+    const float splitSigma = 0.5f * baseRadius;
+    // Batches of one emission arriving this close after each other join the
+    // newest puff instead of starting another one
+    const float joinAge = 0.25f;
+    // Puffs of one emission closer than this share of their width merge
+    const float mergeDistance = 0.5f;
+}
+
+float Puff::getAliveFraction() const {
+    if (maxLife <= minLife)
+        return age < maxLife ? 1.0f : 0.0f;
+    return glm::clamp((maxLife - age) / (maxLife - minLife), 0.0f, 1.0f);
+}
+
+// A particle with remaining life u deposits min(u, 1) per second over its
+// quad. Averaged over lifetimes uniform in [minLife, maxLife], the rate at age
+// t is the integral of min(u, 1) for u from max(minLife - t, 0) to maxLife - t.
+float Puff::getDepositionRate() const {
+    float b = maxLife - age;
+    if (b <= 0.0f)
+        return 0.0f;
+    float a = std::max(minLife - age, 0.0f);
+
+    float integral;
+    if (b <= 1.0f)
+        integral = 0.5f * (b * b - a * a);
+    else if (a >= 1.0f)
+        integral = b - a;
+    else
+        integral = 0.5f * (1.0f - a * a) + (b - 1.0f);
+
+    float spread = maxLife - minLife;
+    float rate = spread > 0.0f ? integral / spread : std::min(b, 1.0f);
+    return rate * meanArea;
+}
+
+float Puff::getFootprintSigma() const {
+    return std::sqrt(sigma * sigma + meanArea / 12.0f);
+}
+
+PuffSystem::PuffSystem(size_t maxPuffs) : maxPuffs(maxPuffs) {
+    puffs.reserve(maxPuffs);
+    children.reserve(maxPuffs);
+}
+
+size_t PuffSystem::emit(const EmissionBatch& batch) {
+    if (batch.count == 0)
+        return 0;
+
+    // Batches of a release arrive step after step; keep adding to the newest
+    // puff of the emission while it is still at the source, or whatever its
+    // age once there is no room for another puff
+    for (auto it = puffs.rbegin(); it != puffs.rend(); ++it) {
+        if (it->emission == batch.emission) {
+            if (it->age < joinAge || puffs.size() >= maxPuffs) {
+                it->mass += static_cast<float>(batch.count);
+                return batch.count;
+            }
+            break;
+        }
+    }
+
+    if (puffs.size() >= maxPuffs)
+        return 0;
+
+    const EmissionParams& params = batch.params;
+    float sizeSpread = params.maxSize - params.minSize;
+    float meanArea = sizeSpread > 0.0f
+        ? (std::pow(params.maxSize, 3.0f) - std::pow(params.minSize, 3.0f)) / (3.0f * sizeSpread)
+        : params.minSize * params.minSize;
+
+    puffs.push_back({ batch.sourcePos, glm::vec3(0.0f), initialSigma, static_cast<float>(batch.count), 0.0f,
+                      batch.emission, params.minLife, params.maxLife, meanArea });
+    return batch.count;
+}
+
+void PuffSystem::update(float deltaTime, const WindGrid& windGrid) {
+    for (Puff& puff : puffs) {
+        glm::vec2 position = glm::vec2(puff.position.x, puff.position.z);
+        glm::vec3 direction;
+        float windVelocity;
+
+        bool hasWind = windField && windField->isBaked()
+            ? windField->sample(position, direction, windVelocity)
+            : windGrid.blendAtPoint(position, direction, windVelocity);
+
+        if (hasWind)
+            puff.drift += (direction * windVelocity * windVelocityScale - puff.drift) * windBlend;
+
+        float speed = glm::length(puff.drift);
+        puff.position += puff.drift * deltaTime;
+        puff.sigma += (growthPerSecond + growthPerDistance * speed) * deltaTime;
+        puff.age += deltaTime;
+    }
+
+    puffs.erase(std::remove_if(puffs.begin(), puffs.end(),
+                               [](const Puff& puff) { return puff.age >= puff.maxLife; }),
+                puffs.end());
+
+    split();
+    merge();
+}
+
+// Each wide puff becomes four at +-sigma along x and z, each sigma / sqrt(2)
+// wide, which keeps the mass and the variance of the original.
+void PuffSystem::split() {
+    children.clear();
+    size_t count = puffs.size();
+
+    for (size_t i = 0; i < puffs.size(); ++i) {
+        Puff& puff = puffs[i];
+        if (puff.sigma <= splitSigma || count + 3 > maxPuffs)
+            continue;
+
+        const float offset = puff.sigma;
+        Puff child = puff;
+        child.sigma = puff.sigma / std::sqrt(2.0f);
+        child.mass = puff.mass / 4.0f;
+
+        const glm::vec3 offsets[] = { { offset, 0.0f, 0.0f }, { -offset, 0.0f, 0.0f },
+                                      { 0.0f, 0.0f, offset }, { 0.0f, 0.0f, -offset } };
+        for (int k = 1; k < 4; ++k) {
+            children.push_back(child);
+            children.back().position += offsets[k];
+        }
+        child.position += offsets[0];
+        puff = child;
+        count += 3;
+    }
+
+    puffs.insert(puffs.end(), children.begin(), children.end());
+}
+
+// Merged puffs keep the mass, the centre of mass and the variance of the pair.
+void PuffSystem::merge() {
+    for (size_t i = 0; i < puffs.size(); ++i) {
+        for (size_t j = i + 1; j < puffs.size(); ) {
+            Puff& a = puffs[i];
+            const Puff& b = puffs[j];
+            float distance = glm::distance(glm::vec2(a.position.x, a.position.z), glm::vec2(b.position.x, b.position.z));
+
+            if (a.emission != b.emission || std::abs(a.age - b.age) > joinAge ||
+                distance > mergeDistance * std::max(a.sigma, b.sigma)) {
+                ++j;
+                continue;
+            }
+
+            float mass = a.mass + b.mass;
+            float wa = a.mass / mass, wb = b.mass / mass;
+            glm::vec3 centre = a.position * wa + b.position * wb;
+            float variance = wa * (a.sigma * a.sigma + glm::dot(a.position - centre, a.position - centre) / 2.0f)
+                           + wb * (b.sigma * b.sigma + glm::dot(b.position - centre, b.position - centre) / 2.0f);
+
+            a.position = centre;
+            a.drift = a.drift * wa + b.drift * wb;
+            a.sigma = std::sqrt(variance);
+            a.age = a.age * wa + b.age * wb;
+            a.mass = mass;
+
+            puffs[j] = puffs.back();
+            puffs.pop_back();
+        }
+    }
+}
+
+void PuffSystem::deposit(DepositionGrid& grid, float deltaTime) const {
+    for (const Puff& puff : puffs) {
+        float amount = puff.mass * puff.getDepositionRate() * deltaTime;
+        if (amount > 0.0f)
+            grid.depositGaussian(glm::vec2(puff.position.x, puff.position.z), puff.getFootprintSigma(), amount);
+    }
+}
+
+double PuffSystem::getAliveMass() const {
+    double alive = 0.0;
+    for (const Puff& puff : puffs)
+        alive += puff.mass * puff.getAliveFraction();
+    return alive;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "deposition_grid.hpp"
+#include "emission_scheduler.hpp"
+#include "wind_field.hpp"
+#include "wind_grid.hpp"
+
+// A Gaussian cloud standing in for many particles of one emission. The cloud
+// carries the particles' mean motion and their spread, and its lifetime and
+// deposition follow the distributions the particles would have been drawn
+// from, so it deposits what they would have deposited on average.
+struct Puff {
+    glm::vec3 position;
+    glm::vec3 drift;  // mean velocity of the particles it stands for
+    float sigma;      // horizontal standard deviation
+    float mass;       // particles it stands for at release
+    float age;
+    uint64_t emission;
+
+    // Lifetime and quad size of the particles, from their EmissionParams
+    float minLife;
+    float maxLife;
+    float meanArea;
+
+    // Share of the particles still alive
+    float getAliveFraction() const;
+    // Deposition per particle of mass and second, at the current age
+    float getDepositionRate() const;
+    // Spread of the deposit: the cloud widened by the particles' quads
+    float getFootprintSigma() const;
+};
+
+// Dispersion engine that releases a few hundred Gaussian puffs instead of one
+// particle per unit of material, so its cost does not grow with the power of
+// the release. Puffs drift with the wind like particles, widen as they
+// travel, split when they grow wider than the wind varies, and merge again
+// when puffs of the same emission overlap.
+class PuffSystem {
+public:
+    static constexpr size_t defaultMaxPuffs = 512;
+
+    explicit PuffSystem(size_t maxPuffs = defaultMaxPuffs);
+
+    // Returns how many of the batch's particles the puffs took on; only short
+    // when every puff is in use and none belongs to the batch's emission
+    size_t emit(const EmissionBatch& batch);
+    void update(float deltaTime, const WindGrid& windGrid);
+    // Adds what the puffs deposit during deltaTime, integrated over each Gaussian
+    void deposit(DepositionGrid& grid, float deltaTime) const;
+
+    // Samples wind from a baked field instead of blending the grid per puff
+    void setWindField(const WindField* field) { windField = field; }
+
+    size_t size() const { return puffs.size(); }
+    size_t getMaxPuffs() const { return maxPuffs; }
+    // Particles the puffs stand for that are still alive
+    double getAliveMass() const;
+    const std::vector<Puff>& getPuffs() const { return puffs; }
+
+private:
+    std::vector<Puff> puffs;
+    std::vector<Puff> children;
+    const WindField* windField = nullptr;
+    const size_t maxPuffs;
+
+    void split();
+    void merge();
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random
+// Numbers: As Easy as 1, 2, 3"). Every output block is a pure function of a
+// 128-bit counter and a 64-bit key, so any value of a stream can be computed
+// independently of the others and on any thread.
+namespace Philox {
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
+
+    inline Counter generate(Counter counter, Key key) {
+        const uint32_t M0 = 0xD2511F53u;
+        const uint32_t M1 = 0xCD9E8D57u;
+        const uint32_t W0 = 0x9E3779B9u;
+        const uint32_t W1 = 0xBB67AE85u;
+
+        for (int round = 0; round < 10; ++round) {
+            if (round > 0) {
+                key[0] += W0;
+                key[1] += W1;
+            }
+
+            uint64_t product0 = static_cast<uint64_t>(M0) * counter[0];
+            uint64_t product1 = static_cast<uint64_t>(M1) * counter[2];
+            counter = {
+                static_cast<uint32_t>(product1 >> 32) ^ counter[1] ^ key[0],
+                static_cast<uint32_t>(product1),
+                static_cast<uint32_t>(product0 >> 32) ^ counter[3] ^ key[1],
+                static_cast<uint32_t>(product0)
+            };
+        }
+
+        return counter;
+    }
+}
+
+// Sequence of uniform numbers identified by (seed, stream, index). Emission uses
+// stream = emission number and index = particle number within the emission,
+// so a particle's random values do not depend on how the work is split.
+class RandomStream {
+public:
+    RandomStream(uint64_t seed, uint64_t stream, uint64_t index) :
+        key({ static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32) }),
+        counter({ static_cast<uint32_t>(index), static_cast<uint32_t>(index >> 32), static_cast<uint32_t>(stream), 0 }) {}
+
+    uint32_t nextUint() {
+        if (used == block.size()) {
+            block = Philox::generate(counter, key);
+            ++counter[3];
+            used = 0;
+        }
+        return block[used++];
+    }
+
+    // Uniform in [0, 1), using the top 24 bits so every value is exact in a float
+    float nextFloat() {
+        return static_cast<float>(nextUint() >> 8) * (1.0f / 16777216.0f);
+    }
+
+    float uniform(float min, float max) {
+        return min + (max - min) * nextFloat();
+    }
+
+private:
+    Philox::Key key;
+    Philox::Counter counter;
+    Philox::Counter block = {};
+    size_t used = 4;
+};
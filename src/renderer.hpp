@@ -12,10 +12,8 @@ namespace Renderer {
     void renderPlane(Program *);
     void renderAxis(Program *);
     void renderPlants(Program *);
-    void renderPlant(Program *, glm::vec3, glm::vec3);
     void renderParticles(Program *);
     void renderWindVectors(Program *);
-    void renderWindVector(Program *, WindVector&);
     glm::mat4 buildProjectionMatrix(Program *);
     void cleanUp();
 }
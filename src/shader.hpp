@@ -3,48 +3,71 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <vector>
 
+#include "camera_uniforms.hpp"
 #include "filesystem/filesystem.h"
 
-class Shader {
-public:
-    unsigned int ID;
-    // constructor generates the shader on the fly
-    // ------------------------------------------------------------------------
-    Shader(const char *vertexPath, const char *fragmentPath) {
-        // 1. retrieve the vertex/fragment source code from filePath
-        std::string vertexCode;
-        std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+// Stage sources of a program, read from disk without a GL context so the
+// asset loader can do it on a worker thread. Transform feedback programs
+// have a geometry stage instead of a fragment stage.
+struct ShaderSource {
+    std::string vertexCode;
+    std::string fragmentCode;
+    std::string geometryCode;
+
+    static ShaderSource read(const char *vertexPath, const char *fragmentPath) {
+        ShaderSource source;
+        source.vertexCode = readFile(vertexPath);
+        source.fragmentCode = readFile(fragmentPath);
+        return source;
+    }
+
+    static ShaderSource readFeedback(const char *vertexPath, const char *geometryPath) {
+        ShaderSource source;
+        source.vertexCode = readFile(vertexPath);
+        source.geometryCode = readFile(geometryPath);
+        return source;
+    }
+
+    // empty if the file can't be read, which then fails to compile
+    static std::string readFile(const char *path) {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try {
-            // open files
-            vShaderFile.open(FileSystem::getPath(vertexPath).c_str());
-            fShaderFile.open(FileSystem::getPath(fragmentPath).c_str());
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
-            // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            shaderFile.open(FileSystem::getPath(path).c_str());
+            std::stringstream shaderStream;
+            // read file's buffer contents into the stream
+            shaderStream << shaderFile.rdbuf();
+            shaderFile.close();
+            return shaderStream.str();
         }
         catch (std::ifstream::failure &e) {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what()
                 << std::endl;
         }
-        const char *vShaderCode = vertexCode.c_str();
-        const char *fShaderCode = fragmentCode.c_str();
+        return std::string();
+    }
+};
+
+class Shader {
+public:
+    unsigned int ID;
+    // constructor generates the shader on the fly
+    // ------------------------------------------------------------------------
+    Shader(const char *vertexPath, const char *fragmentPath) : Shader(ShaderSource::read(vertexPath, fragmentPath)) {}
+    // compiles source already read, e.g. by the asset loader
+    // ------------------------------------------------------------------------
+    Shader(const ShaderSource &source) {
+        const char *vShaderCode = source.vertexCode.c_str();
+        const char *fShaderCode = source.fragmentCode.c_str();
         // 2. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
@@ -63,66 +86,171 @@ public:
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        cacheUniforms();
+        bindCameraBlock();
         // delete the shaders as they're linked into our program now and no longer
         // necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
     }
+    // constructor for transform feedback programs: vertex and geometry stage
+    // only, capturing the given geometry shader outputs interleaved into one
+    // buffer
+    // ------------------------------------------------------------------------
+    Shader(const char *vertexPath, const char *geometryPath, const std::vector<const char *> &feedbackVaryings)
+        : Shader(ShaderSource::readFeedback(vertexPath, geometryPath), feedbackVaryings) {}
+    Shader(const ShaderSource &source, const std::vector<const char *> &feedbackVaryings) {
+        const char *vShaderCode = source.vertexCode.c_str();
+        const char *gShaderCode = source.geometryCode.c_str();
+        unsigned int vertex, geometry;
+        vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        geometry = glCreateShader(GL_GEOMETRY_SHADER);
+        glShaderSource(geometry, 1, &gShaderCode, NULL);
+        glCompileShader(geometry);
+        checkCompileErrors(geometry, "GEOMETRY");
+        // varyings have to be declared before linking
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, geometry);
+        glTransformFeedbackVaryings(ID, static_cast<GLsizei>(feedbackVaryings.size()), feedbackVaryings.data(),
+            GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        cacheUniforms();
+        bindCameraBlock();
+        glDeleteShader(vertex);
+        glDeleteShader(geometry);
+    }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() const { glUseProgram(ID); }
-    // utility uniform functions
+    // utility uniform functions, looked up in the locations cached at link
+    // time; unknown names get -1, which GL ignores. Paths run every frame
+    // keep the location from getUniformLocation() and pass that instead.
+    // ------------------------------------------------------------------------
+    GLint getUniformLocation(std::string_view name) const {
+        auto it = std::lower_bound(uniforms.begin(), uniforms.end(), name,
+            [](const UniformLocation &uniform, std::string_view key) { return std::string_view(uniform.name) < key; });
+        return it != uniforms.end() && it->name == name ? it->location : -1;
+    }
     // ------------------------------------------------------------------------
-    void setBool(const std::string &name, bool value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+    void setBool(GLint location, bool value) const {
+        glUniform1i(location, (int)value);
+    }
+    void setBool(std::string_view name, bool value) const {
+        setBool(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string &name, int value) const {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+    void setInt(GLint location, int value) const {
+        glUniform1i(location, value);
+    }
+    void setInt(std::string_view name, int value) const {
+        setInt(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string &name, float value) const {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+    void setFloat(GLint location, float value) const {
+        glUniform1f(location, value);
+    }
+    void setFloat(std::string_view name, float value) const {
+        setFloat(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string &name, const glm::vec2 &value) const {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec2(GLint location, const glm::vec2 &value) const {
+        glUniform2fv(location, 1, &value[0]);
+    }
+    void setVec2(std::string_view name, const glm::vec2 &value) const {
+        setVec2(getUniformLocation(name), value);
     }
-    void setVec2(const std::string &name, float x, float y) const {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+    void setVec2(std::string_view name, float x, float y) const {
+        glUniform2f(getUniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string &name, const glm::vec3 &value) const {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec3(GLint location, const glm::vec3 &value) const {
+        glUniform3fv(location, 1, &value[0]);
+    }
+    void setVec3(std::string_view name, const glm::vec3 &value) const {
+        setVec3(getUniformLocation(name), value);
     }
-    void setVec3(const std::string &name, float x, float y, float z) const {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+    void setVec3(std::string_view name, float x, float y, float z) const {
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string &name, const glm::vec4 &value) const {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+    void setVec4(GLint location, const glm::vec4 &value) const {
+        glUniform4fv(location, 1, &value[0]);
     }
-    void setVec4(const std::string &name, float x, float y, float z,
+    void setVec4(std::string_view name, const glm::vec4 &value) const {
+        setVec4(getUniformLocation(name), value);
+    }
+    void setVec4(std::string_view name, float x, float y, float z,
         float w) const {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getUniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string &name, const glm::mat2 &mat) const {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-            &mat[0][0]);
+    void setMat2(std::string_view name, const glm::mat2 &mat) const {
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string &name, const glm::mat3 &mat) const {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-            &mat[0][0]);
+    void setMat3(std::string_view name, const glm::mat3 &mat) const {
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string &name, const glm::mat4 &mat) const {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE,
-            &mat[0][0]);
+    void setMat4(GLint location, const glm::mat4 &mat) const {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void setMat4(std::string_view name, const glm::mat4 &mat) const {
+        setMat4(getUniformLocation(name), mat);
     }
 
 private:
+    struct UniformLocation {
+        std::string name;
+        GLint location;
+    };
+    // sorted by name
+    std::vector<UniformLocation> uniforms;
+
+    // records the location of every active uniform outside a block; arrays are
+    // listed under their bare name and every element
+    // ------------------------------------------------------------------------
+    void cacheUniforms() {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(std::max(maxLength, 1));
+
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, i, static_cast<GLsizei>(buffer.size()), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue;
+
+            uniforms.push_back({ name, location });
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string base = name.substr(0, name.size() - 3);
+                uniforms.push_back({ base, location });
+                for (GLint element = 1; element < size; ++element) {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniforms.push_back({ elementName, glGetUniformLocation(ID, elementName.c_str()) });
+                }
+            }
+        }
+        std::sort(uniforms.begin(), uniforms.end(),
+            [](const UniformLocation &a, const UniformLocation &b) { return a.name < b.name; });
+    }
+    // ------------------------------------------------------------------------
+    void bindCameraBlock() {
+        GLuint index = glGetUniformBlockIndex(ID, CameraUniformBuffer::blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, CameraUniformBuffer::binding);
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type) {
@@ -0,0 +1,134 @@
+#include "simulation_thread.hpp"
+
+#include <algorithm>
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start(const WindGrid& windGrid) {
+    if (isRunning())
+        return;
+
+    stopping = false;
+    worker = std::thread(&SimulationThread::run, this, std::cref(windGrid));
+}
+
+void SimulationThread::stop() {
+    if (!isRunning())
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    worker.join();
+}
+
+void SimulationThread::release(const glm::vec3& sourcePos, int powerMW, const ReleaseProfile& profile) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pendingReleases.push_back({ sourcePos, powerMW, profile });
+    }
+    wakeUp.notify_all();
+}
+
+const ParticleSnapshot& SimulationThread::acquireSnapshot() {
+    if (shared.load(std::memory_order_relaxed) & freshBit)
+        front = shared.exchange(front, std::memory_order_acq_rel) & ~freshBit;
+    return snapshots[front];
+}
+
+float SimulationThread::getInterpolationFactor(const ParticleSnapshot& snapshot) const {
+    float scale = timeScale.load();
+    if (scale <= 0.0f)
+        return 1.0f;
+
+    float elapsed = std::chrono::duration<float>(std::chrono::steady_clock::now() - snapshot.published).count();
+    return std::clamp(elapsed * scale / timeStep, 0.0f, 1.0f);
+}
+
+// Steps are paced against the wall clock scaled by timeScale. When a step
+// falls behind by more than a few steps the schedule is reset instead of
+// catching up in a burst. With nothing to simulate the thread sleeps until
+// a release arrives.
+void SimulationThread::run(const WindGrid& windGrid) {
+    using Clock = std::chrono::steady_clock;
+    const int maxLagSteps = 4;
+
+    std::vector<ReleaseCommand> releases;
+    Clock::time_point nextStep = Clock::now();
+    uint64_t step = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            if (simulation.size() == 0 && scheduler.empty()) {
+                wakeUp.wait(lock, [this] { return stopping || !pendingReleases.empty(); });
+                nextStep = Clock::now();
+            }
+
+            float scale = timeScale.load();
+            if (scale > 0.0f)
+                wakeUp.wait_until(lock, nextStep, [this] { return stopping; });
+            if (stopping)
+                return;
+
+            releases.swap(pendingReleases);
+        }
+
+        for (const ReleaseCommand& command : releases)
+            scheduler.schedule(command.sourcePos, command.powerMW, command.profile, simulation.getMaxParticles());
+        releases.clear();
+
+        for (const EmissionBatch& batch : scheduler.collectDue(timeStep, simulation.getAvailable()))
+            simulation.emit(batch);
+
+        simulation.update(timeStep, windGrid);
+        deposition.deposit(simulation.getParticles(), timeStep);
+        publish(++step);
+
+        float scale = timeScale.load();
+        if (scale > 0.0f) {
+            auto stepDuration = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(timeStep / scale));
+            nextStep += stepDuration;
+            if (Clock::now() - nextStep > stepDuration * maxLagSteps)
+                nextStep = Clock::now();
+        }
+    }
+}
+
+// The particles just moved by direction * velocity * timeStep, with the
+// direction and velocity they still hold, so stepping back recovers the
+// previous positions approximately without keeping a copy of the last state.
+// The SIMD kernels round differently (FMA, rsqrt), so it is not bit-exact,
+// but close enough for interpolating between steps. Freshly emitted
+// particles went through the same step, so this holds for them as well.
+void SimulationThread::publish(uint64_t step) {
+    const ParticleData& particles = simulation.getParticles();
+    ParticleSnapshot& snapshot = snapshots[back];
+    const size_t count = particles.size();
+
+    snapshot.positionX.assign(particles.positionX.begin(), particles.positionX.end());
+    snapshot.positionY.assign(particles.positionY.begin(), particles.positionY.end());
+    snapshot.positionZ.assign(particles.positionZ.begin(), particles.positionZ.end());
+    snapshot.intensity.assign(particles.intensity.begin(), particles.intensity.end());
+    snapshot.scale.assign(particles.scale.begin(), particles.scale.end());
+
+    snapshot.previousX.resize(count);
+    snapshot.previousY.resize(count);
+    snapshot.previousZ.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        float distance = particles.velocity[i] * timeStep;
+        snapshot.previousX[i] = particles.positionX[i] - particles.directionX[i] * distance;
+        snapshot.previousY[i] = particles.positionY[i] - particles.directionY[i] * distance;
+        snapshot.previousZ[i] = particles.positionZ[i] - particles.directionZ[i] * distance;
+    }
+
+    snapshot.step = step;
+    snapshot.time = step * static_cast<double>(timeStep);
+    snapshot.published = std::chrono::steady_clock::now();
+
+    back = shared.exchange(back | freshBit, std::memory_order_acq_rel) & ~freshBit;
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "deposition_grid.hpp"
+#include "emission_scheduler.hpp"
+#include "particle_system.hpp"
+#include "wind_grid.hpp"
+
+// What the renderer needs of one simulation step: every particle's position
+// before and after the step, so it can draw any point in between.
+struct ParticleSnapshot {
+    std::vector<float> previousX, previousY, previousZ;
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> intensity;
+    std::vector<float> scale;
+
+    uint64_t step = 0;
+    double time = 0.0; // simulated seconds at the end of the step
+    std::chrono::steady_clock::time_point published;
+
+    size_t size() const { return positionX.size(); }
+
+    glm::vec3 interpolate(size_t i, float alpha) const {
+        return glm::mix(glm::vec3(previousX[i], previousY[i], previousZ[i]),
+                        glm::vec3(positionX[i], positionY[i], positionZ[i]), alpha);
+    }
+};
+
+// Advances a ParticleSystem on its own thread in fixed steps, independent of
+// the frame rate. After every step the particles are copied into a snapshot
+// and handed over through a triple buffer: publishing and acquiring are a
+// single atomic exchange each, so neither side ever waits for the other.
+// Every step also deposits the particles into a grid, which is read under its
+// lock.
+class SimulationThread {
+public:
+    static constexpr float defaultTimeStep = 1.0f / 60.0f;
+
+    explicit SimulationThread(size_t maxParticles = 50000, float timeStep = defaultTimeStep)
+        : simulation(maxParticles), timeStep(timeStep) {}
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    // The grid must stay alive and unchanged until stop()
+    void start(const WindGrid& windGrid);
+    void stop();
+    bool isRunning() const { return worker.joinable(); }
+
+    // Only configure the simulation and the scheduler while the thread is stopped
+    ParticleSystem& getSimulation() { return simulation; }
+    EmissionScheduler& getScheduler() { return scheduler; }
+    DepositionGrid& getDeposition() { return deposition; }
+
+    // Queued and handed to the scheduler before the next step
+    void release(const glm::vec3& sourcePos, int powerMW, const ReleaseProfile& profile);
+
+    // Simulated seconds per wall-clock second; 0 steps as fast as possible
+    void setTimeScale(float scale) { timeScale.store(scale); }
+    float getTimeScale() const { return timeScale.load(); }
+    float getTimeStep() const { return timeStep; }
+
+    // Newest published snapshot, never blocks. The reference stays valid until
+    // the next call; only one thread may acquire.
+    const ParticleSnapshot& acquireSnapshot();
+    // How far the wall clock has moved from the snapshot's previous state
+    // towards its current one, in [0, 1].
+    float getInterpolationFactor(const ParticleSnapshot& snapshot) const;
+
+private:
+    struct ReleaseCommand {
+        glm::vec3 sourcePos;
+        int powerMW;
+        ReleaseProfile profile;
+    };
+
+    ParticleSystem simulation;
+    EmissionScheduler scheduler;
+    DepositionGrid deposition;
+    const float timeStep;
+    std::atomic<float> timeScale{ 1.0f };
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::vector<ReleaseCommand> pendingReleases;
+    bool stopping = false;
+
+    // Snapshot slots: the simulation writes back, the renderer reads front and
+    // shared holds the one in between, with freshBit set while it is unread.
+    static constexpr unsigned int freshBit = 4;
+    ParticleSnapshot snapshots[3];
+    unsigned int back = 0;
+    unsigned int front = 1;
+    std::atomic<unsigned int> shared{ 2 };
+
+    void run(const WindGrid& windGrid);
+    void publish(uint64_t step);
+};
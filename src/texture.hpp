@@ -2,15 +2,19 @@
 
 #include <filesystem/filesystem.h>
 #include <glad/glad.h>
-#include <stb_image/stb_image.h>
 
 #include <iostream>
 
+#include "image_data.hpp"
+
 class Texture {
 public:
     GLuint textureID;
 
-    Texture(const std::string &texturePath) {
+    Texture(const std::string &texturePath) : Texture(load(texturePath)) {}
+
+    // uploads an image decoded elsewhere, e.g. by the asset loader
+    Texture(const ImageData &image) {
         glGenTextures(1, &textureID);
         glBindTexture(GL_TEXTURE_2D, textureID);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -18,21 +22,20 @@ public:
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-        int width, height, nrChannels;
-        stbi_set_flip_vertically_on_load(true);
-        unsigned char *data = stbi_load(FileSystem::getPath(texturePath).c_str(),
-            &width, &height, &nrChannels, 0);
-
-        if (data) {
-            const int format = getFormat(nrChannels);
-            glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-                GL_UNSIGNED_BYTE, data);
+        if (image) {
+            const int format = getFormat(image.channels);
+            glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format,
+                GL_UNSIGNED_BYTE, image.pixels.get());
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR); // No mipmap
         }
         else {
             std::cout << "Failed to load texture" << std::endl;
         }
-        stbi_image_free(data);
+    }
+
+    // reads and decodes a texture relative to the project root; needs no GL
+    static ImageData load(const std::string &texturePath) {
+        return ImageData::load(FileSystem::getPath(texturePath), true);
     }
 
     void bindTexture(GLenum texture) {
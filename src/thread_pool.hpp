@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent set of worker threads that split indexed work with the calling
+// thread. Workers sleep between jobs, so a parallelFor per frame costs a wake-up
+// rather than thread creation.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned int threadCount = defaultThreadCount());
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Calls task(i) for every i in [0, taskCount) and returns once all calls
+    // have finished. Tasks are handed out dynamically, so they must not depend
+    // on which thread runs them. Calls from several threads take turns.
+    void parallelFor(size_t taskCount, const std::function<void(size_t)>& task);
+
+    unsigned int getThreadCount() const { return static_cast<unsigned int>(workers.size()) + 1; }
+
+    static unsigned int defaultThreadCount();
+
+private:
+    std::vector<std::thread> workers;
+    std::mutex callMutex;
+    std::mutex mutex;
+    std::condition_variable wakeUp;
+    std::condition_variable finished;
+
+    const std::function<void(size_t)>* currentTask = nullptr;
+    size_t taskCount = 0;
+    std::atomic<size_t> nextTask{ 0 };
+    size_t activeWorkers = 0;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    void workerLoop();
+    void runTasks();
+};
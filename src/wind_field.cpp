@@ -0,0 +1,109 @@
+#include "wind_field.hpp"
+#include "world_constraints.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void WindField::bake(const WindGrid& windGrid, float cellSize) {
+    this->cellSize = cellSize;
+    origin = glm::vec2(WorldConstraints::MAP_LEFT, WorldConstraints::MAP_TOP);
+    width = static_cast<int>(std::ceil((WorldConstraints::MAP_RIGHT - WorldConstraints::MAP_LEFT) / cellSize)) + 1;
+    height = static_cast<int>(std::ceil((WorldConstraints::MAP_BOTTOM - WorldConstraints::MAP_TOP) / cellSize)) + 1;
+
+    lattice.assign(static_cast<size_t>(width) * height, glm::vec4(0.0f));
+
+    for (int z = 0; z < height; ++z) {
+        for (int x = 0; x < width; ++x) {
+            glm::vec2 position = origin + glm::vec2(x, z) * cellSize;
+            glm::vec3 direction;
+            float velocity;
+
+            if (windGrid.blendAtPoint(position, direction, velocity))
+                lattice[static_cast<size_t>(z) * width + x] = glm::vec4(direction.x, direction.z, velocity, 1.0f);
+        }
+    }
+}
+
+bool WindField::sample(glm::vec2 position, glm::vec3& direction, float& velocity) const {
+    glm::vec2 local = (position - origin) / cellSize;
+    if (local.x < 0.0f || local.y < 0.0f)
+        return false;
+
+    int x = static_cast<int>(local.x);
+    int z = static_cast<int>(local.y);
+    if (x >= width - 1 || z >= height - 1)
+        return false;
+
+    float fx = local.x - x;
+    float fz = local.y - z;
+
+    const glm::vec4* row = &lattice[static_cast<size_t>(z) * width + x];
+    glm::vec4 top = glm::mix(row[0], row[1], fx);
+    glm::vec4 bottom = glm::mix(row[width], row[width + 1], fx);
+    glm::vec4 blended = glm::mix(top, bottom, fz);
+
+    // Nodes without wind carry zero weight; treat the point as calm when they
+    // make up most of the footprint, like the exact blend does past the edge.
+    if (blended.w < 0.5f)
+        return false;
+
+    glm::vec2 dir = glm::vec2(blended.x, blended.y);
+    float length = glm::length(dir);
+    if (length < 1e-6f)
+        return false;
+
+    direction = glm::vec3(dir.x / length, 0.0f, dir.y / length);
+    velocity = blended.z / blended.w;
+    return true;
+}
+
+WindFieldError WindField::measureError(const WindGrid& windGrid, int samplesPerAxis) const {
+    WindFieldError error;
+    int mismatches = 0;
+    int total = 0;
+    double angleSum = 0.0;
+    double velocitySum = 0.0;
+
+    glm::vec2 extent = glm::vec2(WorldConstraints::MAP_RIGHT - WorldConstraints::MAP_LEFT,
+                                 WorldConstraints::MAP_BOTTOM - WorldConstraints::MAP_TOP);
+
+    for (int j = 0; j < samplesPerAxis; ++j) {
+        for (int i = 0; i < samplesPerAxis; ++i) {
+            // Sample at cell centres of a grid that is not aligned with the lattice
+            glm::vec2 t = (glm::vec2(i, j) + 0.5f) / static_cast<float>(samplesPerAxis);
+            glm::vec2 position = glm::vec2(WorldConstraints::MAP_LEFT, WorldConstraints::MAP_TOP) + t * extent;
+
+            glm::vec3 exactDir, bakedDir;
+            float exactVelocity, bakedVelocity;
+            bool exact = windGrid.blendAtPoint(position, exactDir, exactVelocity);
+            bool baked = sample(position, bakedDir, bakedVelocity);
+            ++total;
+
+            if (exact != baked) {
+                ++mismatches;
+                continue;
+            }
+            if (!exact)
+                continue;
+
+            float cosine = glm::clamp(glm::dot(exactDir, bakedDir), -1.0f, 1.0f);
+            float angle = glm::degrees(std::acos(cosine));
+            float velocityError = std::abs(exactVelocity - bakedVelocity);
+
+            angleSum += angle;
+            velocitySum += velocityError;
+            error.maxAngleDeg = std::max(error.maxAngleDeg, angle);
+            error.maxVelocity = std::max(error.maxVelocity, velocityError);
+            ++error.samples;
+        }
+    }
+
+    if (error.samples > 0) {
+        error.meanAngleDeg = static_cast<float>(angleSum / error.samples);
+        error.meanVelocity = static_cast<float>(velocitySum / error.samples);
+    }
+    if (total > 0)
+        error.coverageMismatch = static_cast<float>(mismatches) / total;
+
+    return error;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "wind_grid.hpp"
+
+// Accuracy of a baked field compared with WindGrid::blendAtPoint.
+struct WindFieldError {
+    int samples = 0;
+    float meanAngleDeg = 0.0f;
+    float maxAngleDeg = 0.0f;
+    float meanVelocity = 0.0f;
+    float maxVelocity = 0.0f;
+    float coverageMismatch = 0.0f; // fraction of samples where only one side reports wind
+};
+
+// The wind grid is static, so its blend is evaluated once into a dense lattice
+// over the map and particles sample it bilinearly instead of visiting every
+// nearby wind vector each frame.
+class WindField {
+public:
+    static constexpr float defaultCellSize = 0.1f;
+
+    void bake(const WindGrid& windGrid, float cellSize = defaultCellSize);
+    bool sample(glm::vec2 position, glm::vec3& direction, float& velocity) const;
+    WindFieldError measureError(const WindGrid& windGrid, int samplesPerAxis) const;
+
+    bool isBaked() const { return !lattice.empty(); }
+    float getCellSize() const { return cellSize; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    glm::vec2 getOrigin() const { return origin; }
+    // Row-major nodes, z rows of x; layout as described on the member below
+    const std::vector<glm::vec4>& getLattice() const { return lattice; }
+
+private:
+    // Per node: blended x/z direction and velocity premultiplied by coverage,
+    // then coverage itself (1 where the grid reports wind, 0 elsewhere).
+    std::vector<glm::vec4> lattice;
+    glm::vec2 origin = glm::vec2(0.0f);
+    float cellSize = defaultCellSize;
+    int width = 0;
+    int height = 0;
+};
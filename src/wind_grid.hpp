@@ -4,12 +4,16 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include <algorithm>
 #include <array>
+#include <limits>
 #include <vector>
 
 const float height = 2.0f;
 const glm::vec2 defaultVector = { 1.0f, 0.0f };
 const float baseRadius = 2.0f;
+// Fraction of the wind speed particles pick up
+const float windVelocityScale = 0.10f;
 
 struct WindVector {
     glm::vec2 direction; // x and z direction
@@ -20,7 +24,7 @@ struct WindVector {
     WindVector(glm::vec2 dir, glm::vec2 pos, float vel) :
         direction(dir), position(pos.x, height, pos.y), velocity(vel) {}
 
-    float getAngleRadians() {
+    float getAngleRadians() const {
         glm::vec2 normalizedDirection = glm::normalize(glm::vec2(direction.x, -direction.y));
         glm::vec2 normalizedDefaultVector = glm::normalize(defaultVector);
 
@@ -30,7 +34,7 @@ struct WindVector {
         return atan2(det, dot);
     }
 
-    glm::vec3 getVectorColor() {
+    glm::vec3 getVectorColor() const {
         if (velocity < 30) {
             return glm::vec3(0.0f, 0.0f, 1.0f);
         }
@@ -42,7 +46,7 @@ struct WindVector {
         }
     }
 
-    float getSpeedFactor() {
+    float getSpeedFactor() const {
         if (velocity < 30) {
             return 0.5f;
         }
@@ -53,12 +57,88 @@ struct WindVector {
             return 2.0f;
         }
     }
+
+    // Radius in which this vector affects particles, scaled by its velocity.
+    float getInfluenceRadius() const {
+        float velocityFactor;
+        if (velocity < 30) {
+            velocityFactor = 1.0f;
+        }
+        else if (velocity < 60) {
+            velocityFactor = 1.25f;
+        }
+        else {
+            velocityFactor = 1.5f;
+        }
+        return baseRadius * velocityFactor;
+    }
 };
 
 class WindGrid {
     std::vector<WindVector> windVectors;
 
+    // Uniform grid over the XZ plane. Cell c holds the indices of every wind
+    // vector whose influence circle overlaps it, stored contiguously in
+    // cellEntries[cellStart[c] .. cellStart[c + 1]).
+    const float cellSize = baseRadius;
+    glm::vec2 gridOrigin = glm::vec2(0.0f);
+    int cellsX = 0;
+    int cellsZ = 0;
+    std::vector<unsigned int> cellStart;
+    std::vector<unsigned int> cellEntries;
+    std::vector<float> radiusSquared;
+
 public:
+    // Non-allocating view over the wind vectors that affect a single point.
+    // Iterates the candidates of one grid cell and skips the ones whose
+    // influence radius does not reach the point.
+    class WindVectorRange {
+    public:
+        class iterator {
+        public:
+            iterator(const unsigned int *current, const unsigned int *last, const WindGrid *grid, glm::vec2 point) :
+                current(current), last(last), grid(grid), point(point) {
+                skipUnreachable();
+            }
+
+            const WindVector &operator*() const { return grid->windVectors[*current]; }
+            const WindVector *operator->() const { return &grid->windVectors[*current]; }
+
+            iterator &operator++() {
+                ++current;
+                skipUnreachable();
+                return *this;
+            }
+
+            bool operator==(const iterator &other) const { return current == other.current; }
+            bool operator!=(const iterator &other) const { return current != other.current; }
+
+        private:
+            const unsigned int *current;
+            const unsigned int *last;
+            const WindGrid *grid;
+            glm::vec2 point;
+
+            void skipUnreachable() {
+                while (current != last && !grid->reaches(*current, point))
+                    ++current;
+            }
+        };
+
+        WindVectorRange(const unsigned int *first, const unsigned int *last, const WindGrid *grid, glm::vec2 point) :
+            first(first), last(last), grid(grid), point(point) {}
+
+        iterator begin() const { return iterator(first, last, grid, point); }
+        iterator end() const { return iterator(last, last, grid, point); }
+        bool empty() const { return begin() == end(); }
+
+    private:
+        const unsigned int *first;
+        const unsigned int *last;
+        const WindGrid *grid;
+        glm::vec2 point;
+    };
+
     WindGrid() {
         windVectors.reserve(110);
     }
@@ -83,40 +163,148 @@ public:
         initNordishVectors();
         initSwedishVectors();
         initTurkishVectors();
+
+        buildSpatialIndex();
     }
 
     std::vector<WindVector> &getWindVectors() {
         return windVectors;
     }
 
-    std::vector<WindVector> getWindVectorsAroundPoint(glm::vec3 pos) {
+    const std::vector<WindVector> &getWindVectors() const {
+        return windVectors;
+    }
+
+    WindVectorRange getWindVectorsAroundPoint(glm::vec3 pos) const {
         glm::vec2 position = glm::vec2(pos.x, pos.z);
-        std::vector<WindVector> foundVectors;
-        foundVectors.reserve(8);
+        int cell = cellIndex(position);
+        if (cell < 0)
+            return WindVectorRange(nullptr, nullptr, this, position);
 
-        for (auto &windVector : windVectors) {
+        const unsigned int *entries = cellEntries.data();
+        return WindVectorRange(entries + cellStart[cell], entries + cellStart[cell + 1], this, position);
+    }
+
+    // Inverse-square blend of the wind vectors reaching a point on the XZ plane.
+    // Returns false when nothing has a meaningful influence there; otherwise
+    // direction is the normalized blended direction and velocity the
+    // influence-weighted wind speed.
+    bool blendAtPoint(glm::vec2 position, glm::vec3 &direction, float &velocity) const {
+        glm::vec3 blendedDir(0.0f);
+        float totalWeight = 0.0f;
+        float accumulatedVelocity = 0.0f;
+
+        for (const auto &windVector : getWindVectorsAroundPoint(glm::vec3(position.x, 0.0f, position.y))) {
+            float influence = calculateInfluence(position, windVector);
+            if (influence < 0.01f)
+                continue;
+
+            glm::vec3 windDir3D = glm::normalize(glm::vec3(windVector.direction.x, 0.0f, windVector.direction.y));
+            blendedDir += windDir3D * influence;
+            accumulatedVelocity += windVector.velocity * influence;
+            totalWeight += influence;
+        }
+
+        if (totalWeight < 0.01f)
+            return false;
+
+        direction = glm::normalize(blendedDir / totalWeight);
+        velocity = accumulatedVelocity / totalWeight;
+        return true;
+    }
+
+    static float calculateInfluence(glm::vec2 position, const WindVector &windVector) {
+        glm::vec2 windPos = glm::vec2(windVector.position.x, windVector.position.z);
+        float distance = glm::distance(position, windPos);
+        if (distance < 0.001f)
+            distance = 0.001f;
+
+        return windVector.velocity / (distance * distance + 1.0f);
+    }
+
+private:
+    bool reaches(unsigned int index, glm::vec2 position) const {
+        glm::vec2 windPos = glm::vec2(windVectors[index].position.x, windVectors[index].position.z);
+        glm::vec2 offset = position - windPos;
+        return glm::dot(offset, offset) <= radiusSquared[index];
+    }
+
+    int cellIndex(glm::vec2 position) const {
+        glm::vec2 local = (position - gridOrigin) / cellSize;
+        if (local.x < 0.0f || local.y < 0.0f)
+            return -1;
+
+        int x = static_cast<int>(local.x);
+        int z = static_cast<int>(local.y);
+        if (x >= cellsX || z >= cellsZ)
+            return -1;
+
+        return z * cellsX + x;
+    }
+
+    void buildSpatialIndex() {
+        cellStart.clear();
+        cellEntries.clear();
+        radiusSquared.clear();
+        cellsX = cellsZ = 0;
+
+        if (windVectors.empty())
+            return;
+
+        glm::vec2 minCorner(std::numeric_limits<float>::max());
+        glm::vec2 maxCorner(std::numeric_limits<float>::lowest());
+        for (const auto &windVector : windVectors) {
+            float radius = windVector.getInfluenceRadius();
             glm::vec2 windPos = glm::vec2(windVector.position.x, windVector.position.z);
-            float velocityFactor;
-            if (windVector.velocity < 30) {
-                velocityFactor = 1.0f;
-            }
-            else if (windVector.velocity < 60) {
-                velocityFactor = 1.25f;
-            }
-            else {
-                velocityFactor = 1.5f;
-            }
-            float radius = baseRadius * velocityFactor;
+            minCorner = glm::min(minCorner, windPos - radius);
+            maxCorner = glm::max(maxCorner, windPos + radius);
+            radiusSquared.push_back(radius * radius);
+        }
+
+        gridOrigin = minCorner;
+        cellsX = static_cast<int>((maxCorner.x - minCorner.x) / cellSize) + 1;
+        cellsZ = static_cast<int>((maxCorner.y - minCorner.y) / cellSize) + 1;
 
-            if (glm::distance(position, windPos) <= radius) {
-                foundVectors.push_back(windVector);
+        // Two passes over the same overlap test: count entries per cell, then
+        // scatter the vector indices into their slots.
+        std::vector<unsigned int> counts(cellsX * cellsZ, 0);
+        auto forEachOverlappedCell = [&](unsigned int index, auto &&visit) {
+            const auto &windVector = windVectors[index];
+            glm::vec2 windPos = glm::vec2(windVector.position.x, windVector.position.z);
+            float radius = windVector.getInfluenceRadius();
+
+            int x0 = std::max(0, static_cast<int>((windPos.x - radius - gridOrigin.x) / cellSize));
+            int z0 = std::max(0, static_cast<int>((windPos.y - radius - gridOrigin.y) / cellSize));
+            int x1 = std::min(cellsX - 1, static_cast<int>((windPos.x + radius - gridOrigin.x) / cellSize));
+            int z1 = std::min(cellsZ - 1, static_cast<int>((windPos.y + radius - gridOrigin.y) / cellSize));
+
+            for (int z = z0; z <= z1; ++z) {
+                for (int x = x0; x <= x1; ++x) {
+                    glm::vec2 cellMin = gridOrigin + glm::vec2(x, z) * cellSize;
+                    glm::vec2 closest = glm::clamp(windPos, cellMin, cellMin + cellSize);
+                    glm::vec2 offset = closest - windPos;
+                    if (glm::dot(offset, offset) <= radiusSquared[index])
+                        visit(z * cellsX + x);
+                }
             }
+        };
+
+        for (unsigned int i = 0; i < windVectors.size(); ++i) {
+            forEachOverlappedCell(i, [&](int cell) { ++counts[cell]; });
         }
 
-        return foundVectors;
+        cellStart.assign(counts.size() + 1, 0);
+        for (size_t cell = 0; cell < counts.size(); ++cell) {
+            cellStart[cell + 1] = cellStart[cell] + counts[cell];
+        }
+
+        cellEntries.resize(cellStart.back());
+        std::vector<unsigned int> cursor(cellStart.begin(), cellStart.end() - 1);
+        for (unsigned int i = 0; i < windVectors.size(); ++i) {
+            forEachOverlappedCell(i, [&](int cell) { cellEntries[cursor[cell]++] = i; });
+        }
     }
 
-private:
     void initSpanishWindVectors() {
         std::vector<WindVector> vectors = {
             WindVector(glm::vec2(0.3f, -1.0f), glm::vec2(-20.3f,  12.3f),  80.0f),
@@ -0,0 +1,63 @@
+#include "wind_vector_instances.hpp"
+
+#include <cstddef>
+
+WindVectorInstances::~WindVectorInstances() {
+    if (instanceBuffer)
+        glDeleteBuffers(1, &instanceBuffer);
+    if (vao)
+        glDeleteVertexArrays(1, &vao);
+}
+
+void WindVectorInstances::initialize(const Object& arrow) {
+    arrowVertexCount = arrow.vertexCount;
+
+    glGenVertexArrays(1, &vao);
+    glGenBuffers(1, &instanceBuffer);
+    glBindVertexArray(vao);
+
+    glBindBuffer(GL_ARRAY_BUFFER, arrow.VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, arrow.stride * sizeof(float), reinterpret_cast<void*>(0));
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    auto instanceAttribute = [](GLuint location, GLint size, size_t offset) {
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, sizeof(Instance), reinterpret_cast<void*>(offset));
+        glEnableVertexAttribArray(location);
+        glVertexAttribDivisor(location, 1);
+    };
+    instanceAttribute(1, 3, offsetof(Instance, position));
+    instanceAttribute(2, 1, offsetof(Instance, angle));
+    instanceAttribute(3, 3, offsetof(Instance, color));
+    instanceAttribute(4, 1, offsetof(Instance, speedFactor));
+    instanceAttribute(5, 2, offsetof(Instance, direction));
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void WindVectorInstances::upload(const std::vector<WindVector>& windVectors) {
+    std::vector<Instance> instances;
+    instances.reserve(windVectors.size());
+    for (const WindVector& windVector : windVectors) {
+        instances.push_back({ windVector.position, windVector.getAngleRadians(), windVector.getVectorColor(),
+                              windVector.getSpeedFactor(), windVector.direction });
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(Instance), instances.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    count = instances.size();
+}
+
+void WindVectorInstances::draw(const Shader& shader, GLint outlineLocation) const {
+    if (count == 0)
+        return;
+
+    glBindVertexArray(vao);
+    shader.setBool(outlineLocation, true);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, arrowVertexCount, static_cast<GLsizei>(count));
+    shader.setBool(outlineLocation, false);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, arrowVertexCount, static_cast<GLsizei>(count));
+    glBindVertexArray(0);
+}
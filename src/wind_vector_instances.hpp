@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "object.hpp"
+#include "shader.hpp"
+#include "wind_grid.hpp"
+
+// Draws every wind vector arrow with two instanced draws, the white outline
+// and the coloured arrow on top. Each vector's placement, colour and speed are
+// uploaded once as instance data; wind_vector.vs builds the arrow's transform
+// and animates it from the time uniform.
+class WindVectorInstances {
+public:
+    WindVectorInstances() = default;
+    ~WindVectorInstances();
+
+    WindVectorInstances(const WindVectorInstances&) = delete;
+    WindVectorInstances& operator=(const WindVectorInstances&) = delete;
+
+    // Reads the arrow's vertices from its buffer rather than copying them
+    void initialize(const Object& arrow);
+    // Call again whenever the wind vectors change
+    void upload(const std::vector<WindVector>& windVectors);
+    // Expects shader in use with the time uniform set; outlineLocation is
+    // where its outline flag is
+    void draw(const Shader& shader, GLint outlineLocation) const;
+
+    size_t size() const { return count; }
+
+private:
+    // Layout of the instance buffer, attribute locations 1 to 5
+    struct Instance {
+        glm::vec3 position;
+        float angle;
+        glm::vec3 color;
+        float speedFactor;
+        glm::vec2 direction;
+    };
+
+    GLuint vao = 0;
+    GLuint instanceBuffer = 0;
+    GLsizei arrowVertexCount = 0;
+    size_t count = 0;
+};
@@ -12,4 +12,10 @@ namespace WorldConstraints {
     // Positive z is at the bottom, negative z at the back
     const float TOP = -SCALE + 15.0f;
     const float BOTTOM = SCALE + 5.0f;
+
+    // Extent of the map plane itself, LEFT..BOTTOM above only constrain the camera
+    const float MAP_LEFT = -SCALE * ASPECT_RATIO;
+    const float MAP_RIGHT = SCALE * ASPECT_RATIO;
+    const float MAP_TOP = -SCALE;
+    const float MAP_BOTTOM = SCALE;
 }
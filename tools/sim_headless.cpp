@@ -0,0 +1,423 @@
+// Runs the simulation without a window or GL context: releases one power
+// plant, advances the particles for a number of fixed steps while
+// accumulating ground deposition, and prints timing and particle statistics.
+// Meant for profiling and for regression runs on machines without a GPU.
+//
+// usage: sim_headless [--steps N] [--dt seconds] [--plant name|index]
+//                     [--power MW] [--max-particles N] [--threads N]
+//                     [--seed N] [--report-every N] [--exact-wind]
+//                     [--release instant|constant|decaying] [--duration seconds]
+//                     [--budget particles per step] [--engine particles|puffs|eulerian]
+//                     [--grid-scale N] [--regions png] [--region-names txt]
+//                     [--population png] [--population-scale people per unit]
+//                     [--decay nuclide] [--days-per-second N]
+//
+// With --decay the deposition decays every step as the viewer's does, and a
+// value held at the viewer's half-float precision is decayed alongside it;
+// the run fails if that value strays from the exact decay, as it would if
+// per-step factors were rounded away.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+
+#include <glm/gtc/packing.hpp>
+
+#include "decay_accumulator.hpp"
+#include "deposition_grid.hpp"
+#include "eulerian_solver.hpp"
+#include "exposure_map.hpp"
+#include "nuclides.hpp"
+#include "particle_system.hpp"
+#include "power_plants.hpp"
+#include "puff_system.hpp"
+#include "thread_pool.hpp"
+#include "wind_field.hpp"
+#include "wind_grid.hpp"
+
+struct Scenario {
+    int steps = 600;
+    float dt = 1.0f / 60.0f;
+    std::string plant = "0";
+    float powerMW = -1.0f; // plant's own power when negative
+    size_t maxParticles = 50000;
+    unsigned int threads = ThreadPool::defaultThreadCount();
+    uint64_t seed = EmissionSequence::defaultSeed;
+    int reportEvery = 60;
+    bool exactWind = false;
+    std::string release = "instant";
+    float duration = 60.0f;
+    size_t budget = EmissionScheduler::defaultBudget;
+    std::string engine = "particles";
+    int gridScale = 1; // deposition resolution as a multiple of 1200x800
+    std::string regions;
+    std::string regionNames;
+    std::string population;
+    float populationScale = 1.0f;
+    std::string decay; // nuclide name, none when empty
+    double daysPerSecond = 1.0;
+};
+
+// The step loop drives either dispersion engine through this
+struct Engine {
+    virtual ~Engine() = default;
+    virtual size_t getAvailable() const = 0;
+    virtual size_t emit(const EmissionBatch &batch) = 0;
+    virtual void update(float deltaTime, const WindGrid &windGrid) = 0;
+    virtual void deposit(DepositionGrid &deposition, float deltaTime) = 0;
+    // Elements the engine is simulating, particles or puffs
+    virtual size_t size() const = 0;
+    // Particles alive, or the particles the puffs or the field stand for
+    virtual double getAlive() const = 0;
+    // Engines that deposit into a grid of their own return it here
+    virtual DepositionGrid *getDeposition() { return nullptr; }
+};
+
+struct ParticleEngine : Engine {
+    ParticleSystem particleSystem;
+
+    explicit ParticleEngine(size_t maxParticles) : particleSystem(maxParticles) {}
+    size_t getAvailable() const override { return particleSystem.getAvailable(); }
+    size_t emit(const EmissionBatch &batch) override { return particleSystem.emit(batch); }
+    void update(float deltaTime, const WindGrid &windGrid) override { particleSystem.update(deltaTime, windGrid); }
+    void deposit(DepositionGrid &deposition, float deltaTime) override {
+        deposition.deposit(particleSystem.getParticles(), deltaTime);
+    }
+    size_t size() const override { return particleSystem.size(); }
+    double getAlive() const override { return static_cast<double>(particleSystem.size()); }
+};
+
+// Puffs take any amount of material, so the release is never held back
+struct PuffEngine : Engine {
+    PuffSystem puffSystem;
+
+    size_t getAvailable() const override { return std::numeric_limits<size_t>::max(); }
+    size_t emit(const EmissionBatch &batch) override { return puffSystem.emit(batch); }
+    void update(float deltaTime, const WindGrid &windGrid) override { puffSystem.update(deltaTime, windGrid); }
+    void deposit(DepositionGrid &deposition, float deltaTime) override { puffSystem.deposit(deposition, deltaTime); }
+    size_t size() const override { return puffSystem.size(); }
+    double getAlive() const override { return puffSystem.getAliveMass(); }
+};
+
+// Deposits into its own grid at the solver's resolution while it updates
+struct EulerianEngine : Engine {
+    EulerianSolver solver;
+
+    size_t getAvailable() const override { return std::numeric_limits<size_t>::max(); }
+    size_t emit(const EmissionBatch &batch) override {
+        solver.emit(batch);
+        return batch.count;
+    }
+    void update(float deltaTime, const WindGrid &windGrid) override { solver.update(deltaTime, windGrid); }
+    void deposit(DepositionGrid &, float) override {}
+    // Material below one particle's worth no longer counts as a plume
+    size_t size() const override { return solver.getAirborneMass() >= 1.0 ? solver.getWidth() * solver.getHeight() : 0; }
+    double getAlive() const override { return solver.getAirborneMass(); }
+    DepositionGrid *getDeposition() override { return &solver.getDeposition(); }
+};
+
+static void printUsage() {
+    std::cout << "usage: sim_headless [--steps N] [--dt seconds] [--plant name|index]\n"
+                 "                    [--power MW] [--max-particles N] [--threads N]\n"
+                 "                    [--seed N] [--report-every N] [--exact-wind]\n"
+                 "                    [--release instant|constant|decaying] [--duration seconds]\n"
+                 "                    [--budget particles per step] [--engine particles|puffs|eulerian]\n"
+                 "                    [--grid-scale N] [--regions png] [--region-names txt]\n"
+                 "                    [--population png] [--population-scale people per unit]\n"
+                 "                    [--decay nuclide] [--days-per-second N]\n";
+}
+
+static bool parseArguments(int argc, char **argv, Scenario &scenario) {
+    for (int i = 1; i < argc; ++i) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+        if (std::strcmp(arg, "--exact-wind") == 0) {
+            scenario.exactWind = true;
+            continue;
+        }
+        if (!value) {
+            std::cerr << "[sim_headless] ERROR: missing value for " << arg << "\n";
+            return false;
+        }
+
+        if (std::strcmp(arg, "--steps") == 0)
+            scenario.steps = std::atoi(value);
+        else if (std::strcmp(arg, "--dt") == 0)
+            scenario.dt = static_cast<float>(std::atof(value));
+        else if (std::strcmp(arg, "--plant") == 0)
+            scenario.plant = value;
+        else if (std::strcmp(arg, "--power") == 0)
+            scenario.powerMW = static_cast<float>(std::atof(value));
+        else if (std::strcmp(arg, "--max-particles") == 0)
+            scenario.maxParticles = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--threads") == 0)
+            scenario.threads = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--seed") == 0)
+            scenario.seed = std::strtoull(value, nullptr, 0);
+        else if (std::strcmp(arg, "--report-every") == 0)
+            scenario.reportEvery = std::atoi(value);
+        else if (std::strcmp(arg, "--release") == 0)
+            scenario.release = value;
+        else if (std::strcmp(arg, "--duration") == 0)
+            scenario.duration = static_cast<float>(std::atof(value));
+        else if (std::strcmp(arg, "--budget") == 0)
+            scenario.budget = std::strtoull(value, nullptr, 10);
+        else if (std::strcmp(arg, "--engine") == 0)
+            scenario.engine = value;
+        else if (std::strcmp(arg, "--grid-scale") == 0)
+            scenario.gridScale = std::max(1, std::atoi(value));
+        else if (std::strcmp(arg, "--regions") == 0)
+            scenario.regions = value;
+        else if (std::strcmp(arg, "--region-names") == 0)
+            scenario.regionNames = value;
+        else if (std::strcmp(arg, "--population") == 0)
+            scenario.population = value;
+        else if (std::strcmp(arg, "--population-scale") == 0)
+            scenario.populationScale = std::strtof(value, nullptr);
+        else if (std::strcmp(arg, "--decay") == 0)
+            scenario.decay = value;
+        else if (std::strcmp(arg, "--days-per-second") == 0)
+            scenario.daysPerSecond = std::atof(value);
+        else {
+            std::cerr << "[sim_headless] ERROR: unknown argument " << arg << "\n";
+            return false;
+        }
+        ++i;
+    }
+
+    if (scenario.steps < 0 || scenario.dt <= 0.0f) {
+        std::cerr << "[sim_headless] ERROR: steps must be >= 0 and dt > 0\n";
+        return false;
+    }
+    if (scenario.release != "instant" && scenario.release != "constant" && scenario.release != "decaying") {
+        std::cerr << "[sim_headless] ERROR: unknown release " << scenario.release << "\n";
+        return false;
+    }
+    if (scenario.engine != "particles" && scenario.engine != "puffs" && scenario.engine != "eulerian") {
+        std::cerr << "[sim_headless] ERROR: unknown engine " << scenario.engine << "\n";
+        return false;
+    }
+    return true;
+}
+
+static ReleaseProfile makeProfile(const Scenario &scenario, float powerMW) {
+    uint64_t total = ParticleEmission::getReleaseCount(powerMW);
+    if (scenario.release == "constant")
+        return ReleaseProfile::constant(total, scenario.duration);
+    if (scenario.release == "decaying")
+        return ReleaseProfile::decaying(total, scenario.duration / 4.0f, scenario.duration);
+    return ReleaseProfile::instant(total);
+}
+
+static const PowerPlant *findPlant(const std::vector<PowerPlant> &plants, const std::string &key) {
+    for (const PowerPlant &plant : plants) {
+        if (plant.name == key)
+            return &plant;
+    }
+
+    char *end = nullptr;
+    long index = std::strtol(key.c_str(), &end, 10);
+    if (end != key.c_str() && *end == '\0' && index >= 0 && index < static_cast<long>(plants.size()))
+        return &plants[index];
+    return nullptr;
+}
+
+int main(int argc, char **argv) {
+    Scenario scenario;
+    if (!parseArguments(argc, argv, scenario)) {
+        printUsage();
+        return 1;
+    }
+
+    const std::vector<PowerPlant> plants = PowerPlants::getDefaultPlants();
+    const PowerPlant *plant = findPlant(plants, scenario.plant);
+    if (!plant) {
+        std::cerr << "[sim_headless] ERROR: unknown plant " << scenario.plant << "\n";
+        return 1;
+    }
+    const float powerMW = scenario.powerMW > 0.0f ? scenario.powerMW : plant->powerMW;
+
+    double halfLifeDays = 0.0;
+    if (!scenario.decay.empty()) {
+        for (const Nuclide &nuclide : Nuclides::getDefaultNuclides()) {
+            if (nuclide.name == scenario.decay)
+                halfLifeDays = nuclide.halfLifeDays;
+        }
+        if (halfLifeDays <= 0.0) {
+            std::cerr << "[sim_headless] ERROR: unknown nuclide " << scenario.decay << "\n";
+            return 1;
+        }
+    }
+
+    WindGrid windGrid;
+    windGrid.initialize();
+
+    WindField windField;
+    if (!scenario.exactWind)
+        windField.bake(windGrid);
+
+    ThreadPool threadPool(scenario.threads);
+    const WindField *field = scenario.exactWind ? nullptr : &windField;
+    std::unique_ptr<Engine> engine;
+
+    if (scenario.engine == "eulerian") {
+        auto eulerian = std::make_unique<EulerianEngine>();
+        eulerian->solver.setWindField(field);
+        eulerian->solver.setThreadPool(&threadPool);
+        engine = std::move(eulerian);
+    }
+    else if (scenario.engine == "puffs") {
+        auto puffs = std::make_unique<PuffEngine>();
+        puffs->puffSystem.setWindField(field);
+        engine = std::move(puffs);
+    }
+    else {
+        auto particles = std::make_unique<ParticleEngine>(scenario.maxParticles);
+        particles->particleSystem.setWindField(field);
+        particles->particleSystem.setThreadPool(&threadPool);
+        engine = std::move(particles);
+    }
+
+    EmissionScheduler scheduler;
+    scheduler.setSeed(scenario.seed);
+    scheduler.setBudget(scenario.budget);
+
+    DepositionGrid sharedDeposition(1200 * scenario.gridScale, 800 * scenario.gridScale);
+    sharedDeposition.setThreadPool(&threadPool);
+    DepositionGrid &deposition = engine->getDeposition() ? *engine->getDeposition() : sharedDeposition;
+
+    // Exposure is totalled after every step once either raster is given
+    ExposureMap exposure;
+    if (!scenario.regions.empty())
+        exposure.loadRegions(scenario.regions, scenario.regionNames);
+    if (!scenario.population.empty())
+        exposure.loadPopulation(scenario.population, scenario.populationScale);
+    const bool trackExposure = exposure.hasRegions() || exposure.hasPopulation();
+
+    std::cout << "plant=" << plant->name << " power=" << powerMW << " MW"
+              << " engine=" << scenario.engine
+              << " steps=" << scenario.steps << " dt=" << scenario.dt
+              << " threads=" << threadPool.getThreadCount()
+              << " kernel=" << ParticleKernels::getKernelName(ParticleKernels::detectBestKernel())
+              << " wind=" << (scenario.exactWind ? "exact" : "baked")
+              << " release=" << scenario.release;
+    if (scenario.release != "instant")
+        std::cout << " over " << scenario.duration << " s";
+    std::cout << " budget=" << scenario.budget << "/step\n";
+
+    scheduler.schedule(plant->getEmissionPoint(), powerMW, makeProfile(scenario, powerMW), scenario.maxParticles);
+
+    // One texel of the viewer's R16F mask, decayed the way the viewer does
+    DecayAccumulator maskDecay;
+    float maskValue = 1.0f;
+    double decayedDays = 0.0;
+
+    double emitMs = 0.0, updateMs = 0.0, depositMs = 0.0, exposureMs = 0.0, worstMs = 0.0;
+    uint64_t emitted = 0;
+    size_t peakSize = 0;
+    int stepsRun = 0;
+
+    for (int step = 1; step <= scenario.steps && (engine->size() > 0 || !scheduler.empty()); ++step) {
+        auto emitStart = std::chrono::steady_clock::now();
+        for (const EmissionBatch &batch : scheduler.collectDue(scenario.dt, engine->getAvailable()))
+            emitted += engine->emit(batch);
+
+        auto start = std::chrono::steady_clock::now();
+        engine->update(scenario.dt, windGrid);
+        auto updated = std::chrono::steady_clock::now();
+        engine->deposit(deposition, scenario.dt);
+        if (halfLifeDays > 0.0) {
+            const double days = scenario.dt * scenario.daysPerSecond;
+            const double factor = std::exp2(-days / halfLifeDays);
+            decayedDays += days;
+            deposition.decay(factor);
+
+            const float step = maskDecay.take(factor);
+            if (step != 1.0f)
+                maskValue = glm::unpackHalf1x16(glm::packHalf1x16(maskValue * step));
+        }
+        auto end = std::chrono::steady_clock::now();
+        if (trackExposure) {
+            exposure.update(deposition, &threadPool);
+            exposureMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - end).count();
+        }
+
+        double stepEmitMs = std::chrono::duration<double, std::milli>(start - emitStart).count();
+        double stepUpdateMs = std::chrono::duration<double, std::milli>(updated - start).count();
+        double stepDepositMs = std::chrono::duration<double, std::milli>(end - updated).count();
+        emitMs += stepEmitMs;
+        updateMs += stepUpdateMs;
+        depositMs += stepDepositMs;
+        worstMs = std::max(worstMs, stepEmitMs + stepUpdateMs + stepDepositMs);
+        peakSize = std::max(peakSize, engine->size());
+        stepsRun = step;
+
+        if (scenario.reportEvery > 0 && step % scenario.reportEvery == 0) {
+            std::cout << "step=" << step
+                      << " t=" << std::fixed << std::setprecision(2) << step * scenario.dt << " s"
+                      << std::defaultfloat << std::setprecision(6)
+                      << " " << scenario.engine << "=" << engine->size()
+                      << " alive=" << engine->getAlive()
+                      << " emitted=" << emitted
+                      << " emit=" << stepEmitMs << " ms"
+                      << " update=" << stepUpdateMs << " ms"
+                      << " deposit=" << stepDepositMs << " ms\n";
+        }
+    }
+
+    // Bands match the colours of the contamination overlay
+    const size_t cells = static_cast<size_t>(deposition.getWidth()) * deposition.getHeight();
+    auto percentAbove = [&](float threshold) { return 100.0 * deposition.countAbove(threshold) / cells; };
+
+    std::cout << "\nemitted=" << emitted << " still due=" << scheduler.getBacklog() << "\n"
+              << "steps run=" << stepsRun << " simulated=" << stepsRun * scenario.dt << " s"
+              << " " << scenario.engine << "=" << engine->size() << " peak=" << peakSize << "\n";
+    if (stepsRun > 0) {
+        std::cout << "emit mean=" << emitMs / stepsRun << " ms"
+                  << " update mean=" << updateMs / stepsRun << " ms"
+                  << " deposit mean=" << depositMs / stepsRun << " ms"
+                  << " worst step=" << worstMs << " ms\n";
+        if (trackExposure)
+            std::cout << "exposure mean=" << exposureMs / stepsRun << " ms\n";
+    }
+    std::cout << "deposition total=" << deposition.getTotal()
+              << " max=" << deposition.getMax()
+              << " area >0.001/>0.2/>0.7=" << percentAbove(0.001f) << "/" << percentAbove(0.2f)
+              << "/" << percentAbove(0.7f) << " % of map\n";
+    std::cout << "deposition grid=" << deposition.getWidth() << "x" << deposition.getHeight()
+              << " tiles=" << deposition.getAllocatedTiles() << "/" << deposition.getTilesX() * deposition.getTilesZ()
+              << " memory=" << deposition.getMemoryBytes() / 1048576.0 << " MiB"
+              << " (dense " << cells * sizeof(float) / 1048576.0 << " MiB)\n";
+
+    // The mask may trail the exact decay by one gathered step, plus rounding
+    if (halfLifeDays > 0.0) {
+        const double expected = std::exp2(-decayedDays / halfLifeDays);
+        std::cout << "decay " << scenario.decay << " over " << decayedDays << " days: expected=" << expected
+                  << " half-float mask=" << maskValue << "\n";
+        if (std::abs(maskValue - expected) > 2.0 * DecayAccumulator::minStep * expected + 1e-3) {
+            std::cerr << "[sim_headless] ERROR: half-float decay strayed from " << expected << "\n";
+            return 1;
+        }
+    }
+
+    if (trackExposure) {
+        std::cout << "\nexposure deposited=" << exposure.getTotalDeposited()
+                  << " person dose=" << exposure.getTotalPersonDose() << "\n";
+        for (const RegionExposure &region : exposure.getRegions()) {
+            if (region.deposited > 0.0)
+                std::cout << "  " << region.name << ": deposited=" << region.deposited
+                          << " population=" << region.population
+                          << " person dose=" << region.personDose << "\n";
+        }
+    }
+
+    return 0;
+}